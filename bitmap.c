@@ -1,7 +1,6 @@
 #include <memory.h> // memcpy
 #include <stdlib.h> // malloc
 #include "bitmap.h"
-#include "util.h"
 
 /*
  * BITMAP GETTERS
@@ -84,10 +83,17 @@ uint32_t getColorPaletteSize(const uint8_t* imgIn) {
 /*
  * Get padding from bitmap width in bytes (all bitmaps are 32 Bit padded)
  */
-uint8_t getBitmapPaddingFromWidth(const uint8_t width) {
+uint8_t getBitmapPaddingFromWidth(const size_t width) {
     return width % 4 == 0 ? 0 : 4 - (width % 4);
 }
 
+/*
+ * Get size of one scan line in bytes for 'bitCount' bits per pixel (all bitmaps are 32 Bit padded)
+ */
+size_t getBitmapLineSize(const size_t width, const uint16_t bitCount) {
+    return ((width * bitCount + 31) / 32) * 4;
+}
+
 /*
  * Check if information header size corresponds to either BitmapCoreHeader, BitmapInfoHeader, BitmapV4Header or BitmapV5Header size
  */
@@ -95,14 +101,38 @@ uint8_t isInfoHeaderSizeValid(const uint32_t infoHeaderSize) {
     return infoHeaderSize == BITMAPCOREHEADER_SIZE || infoHeaderSize == BITMAPINFOHEADER_SIZE || infoHeaderSize == BITMAPV4HEADER_SIZE || infoHeaderSize == BITMAPV5HEADER_SIZE;
 }
 
+/*
+ * Read every header field needed for validation and compression from 'imgIn' of 'size' bytes
+ * fields of the BitmapInfoHeader are only read if 'imgIn' is large enough, otherwise they are 0
+ */
+void parseBitmapHeader(const uint8_t* imgIn, const long size, struct bitmapHeader* header) {
+    header->fileType = getFileType(imgIn);
+    header->fileSize = getFileSize(imgIn);
+    header->offBits = getOffBits(imgIn);
+    header->infoHeaderSize = getInfoHeaderSize(imgIn);
+    header->isCoreHeader = header->infoHeaderSize == BITMAPCOREHEADER_SIZE;
+    header->width = getWidth(imgIn);
+    // top-down bitmaps have a negative height, INT32_MIN has no positive counterpart and is too high anyway
+    const int32_t height = getHeight(imgIn);
+    header->isTopDown = height < 0;
+    header->height = height == INT32_MIN ? INT32_MAX : abs(height);
+    header->planes = getPlanes(imgIn);
+    header->bitCount = getBitCount(imgIn);
+    header->colorPaletteSize = header->offBits - header->infoHeaderSize - BITMAPFILEHEADER_SIZE;
+    const uint8_t hasInfoFields = !header->isCoreHeader && size >= BITMAPFILEHEADER_SIZE + BITMAPINFOHEADER_SIZE;
+    header->compression = hasInfoFields ? getCompression(imgIn) : BI_RGB;
+    header->clrUsed = hasInfoFields ? getClrUsed(imgIn) : 0;
+    header->clrImportant = hasInfoFields ? getClrImportant(imgIn) : 0;
+}
+
 /*
  * Validates BitmapCoreHeader specifics
  * returns 'SUCCESS_BITMAP_VALIDATION' if success or 'ERROR_*' if not valid
  */
-uint8_t validateCoreInfoHeader(const uint8_t* imgIn) {
+uint8_t validateCoreInfoHeader(const struct bitmapHeader* header) {
     // no need to check file size as already checked in function 'validate'
-    if (getOffBits(imgIn) < MIN_CORE_OFF_BITS || getOffBits(imgIn) > MAX_CORE_OFF_BITS) return ERROR_WRONG_OFF_BITS;
-    if (getColorPaletteSize(imgIn) % 3 != 0 || getColorPaletteSize(imgIn) < MIN_CORE_COLOR_PALETTE_SIZE || getColorPaletteSize(imgIn) > MAX_CORE_COLOR_PALETTE_SIZE) return ERROR_INVALID_COLOR_PALETTE_SIZE;
+    if (header->offBits < MIN_CORE_OFF_BITS || header->offBits > MAX_CORE_OFF_BITS) return ERROR_WRONG_OFF_BITS;
+    if (header->colorPaletteSize % 3 != 0 || header->colorPaletteSize < MIN_CORE_COLOR_PALETTE_SIZE || header->colorPaletteSize > MAX_CORE_COLOR_PALETTE_SIZE) return ERROR_INVALID_COLOR_PALETTE_SIZE;
     return SUCCESS_BITMAP_VALIDATION;
 }
 
@@ -110,36 +140,103 @@ uint8_t validateCoreInfoHeader(const uint8_t* imgIn) {
  * Validates BitmapInfoHeader specifics
  * returns 'SUCCESS_BITMAP_VALIDATION' if success or 'ERROR_*' if not valid
  */
-uint8_t validateInfoHeader(const uint8_t* imgIn) {
-    uint32_t infoHeaderSize = getInfoHeaderSize(imgIn);
-    if (getFileSize(imgIn) < MIN_INFO_BITMAP_SIZE) return ERROR_TOO_SMALL;
-    if (getOffBits(imgIn) < MIN_INFO_OFF_BITS || getOffBits(imgIn) > MAX_INFO_OFF_BITS) return ERROR_WRONG_OFF_BITS;
-    if (!isInfoHeaderSizeValid(infoHeaderSize)) return ERROR_INVALID_INFO_HEADER_SIZE; // check header size
-    if (getCompression(imgIn) != BI_RGB) return ERROR_ALREADY_COMPRESSED; // check if uncompressed
-    if (getClrUsed(imgIn) > 256) return ERROR_CLR_USED;
-    if (getClrImportant(imgIn) > 256) return ERROR_CLR_IMPORTANT;
-    if (getColorPaletteSize(imgIn) % 4 != 0 || getColorPaletteSize(imgIn) < MIN_INFO_COLOR_PALETTE_SIZE || getColorPaletteSize(imgIn) > MAX_INFO_COLOR_PALETTE_SIZE) return ERROR_INVALID_COLOR_PALETTE_SIZE;
+uint8_t validateInfoHeader(const struct bitmapHeader* header, const uint32_t compression) {
+    if (header->fileSize < MIN_INFO_BITMAP_SIZE) return ERROR_TOO_SMALL;
+    if (header->offBits < MIN_INFO_OFF_BITS || header->offBits > MAX_INFO_OFF_BITS) return ERROR_WRONG_OFF_BITS;
+    if (!isInfoHeaderSizeValid(header->infoHeaderSize)) return ERROR_INVALID_INFO_HEADER_SIZE; // check header size
+    if (header->compression != compression) return compression == BI_RGB ? ERROR_ALREADY_COMPRESSED : ERROR_NOT_COMPRESSED; // check compression
+    if (header->clrUsed > 256) return ERROR_CLR_USED;
+    if (header->clrImportant > 256) return ERROR_CLR_IMPORTANT;
+    if (header->colorPaletteSize % 4 != 0 || header->colorPaletteSize < MIN_INFO_COLOR_PALETTE_SIZE || header->colorPaletteSize > MAX_INFO_COLOR_PALETTE_SIZE) return ERROR_INVALID_COLOR_PALETTE_SIZE;
     return SUCCESS_BITMAP_VALIDATION;
 }
 
 /*
- * Validates if bitmap is valid for being compressed
+ * Validates the size of the uncompressed pixel data, width and height are only bounded by the 32 bit file size
+ * uncompressed pixel data has to be inside of the file, decompressed pixel data has to fit into a bitmap file
  * returns 'SUCCESS_BITMAP_VALIDATION' if success or 'ERROR_*' if not valid
  */
-uint8_t validateBitmap(const uint8_t* imgIn, const long size) {
+static uint8_t validatePixelDataSize(const struct bitmapHeader* header, const long size, const uint32_t compression) {
+    const uint64_t pixelDataSize = (uint64_t)getBitmapLineSize(header->width, header->bitCount) * header->height;
+    if (compression == BI_RGB && header->offBits + pixelDataSize > (uint64_t)size) return ERROR_INVALID_FILE_SIZE;
+    if (header->offBits + pixelDataSize > MAX_BITMAP_FILE_SIZE) return ERROR_TOO_LARGE;
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+/*
+ * Validates if bitmap is a valid 8bpp or 4bpp bitmap using 'compression', the header is parsed once into 'header'
+ * returns 'SUCCESS_BITMAP_VALIDATION' if success or 'ERROR_*' if not valid
+ */
+uint8_t parseBitmapWithCompression(const uint8_t* imgIn, const long size, const uint32_t compression, struct bitmapHeader* header) {
 
     if (size < MIN_BITMAP_SIZE) return ERROR_TOO_SMALL; // is at least min size
-    if (getFileType(imgIn) != BITMAP_FILE_TYPE) return ERROR_WRONG_FILE_TYPE; // file type equals bitmap spec
-    if ((long)getFileSize(imgIn) != size) return ERROR_INVALID_FILE_SIZE; // specified file size equals real file size
+    parseBitmapHeader(imgIn, size, header);
+    if (header->fileType != BITMAP_FILE_TYPE) return ERROR_WRONG_FILE_TYPE; // file type equals bitmap spec
+    if ((long)header->fileSize != size) return ERROR_INVALID_FILE_SIZE; // specified file size equals real file size
 
-    if (getWidth(imgIn) == 0 || getWidth(imgIn) > 7680) return ERROR_WRONG_WIDTH; // check width 8K resolution
-    if (getHeight(imgIn) == 0 || getHeight(imgIn) > 7680) return ERROR_WRONG_HEIGHT; // check height 8K resolution
-    if (getHeight(imgIn) < 0) return ERROR_NO_TOP_DOWN; // check if top down bitmap
-    if (getPlanes(imgIn) != 1) return ERROR_WRONG_PLANES; // check if planes is 1
-    if (getBitCount(imgIn) != BITS_PER_PIXEL) return ERROR_BITS_PER_PIXEL; // is 8bpp bitmap 
+    if (header->width <= 0) return ERROR_WRONG_WIDTH; // check width
+    if (header->height == 0) return ERROR_WRONG_HEIGHT; // check height
+    if (header->isTopDown && compression != BI_RGB) return ERROR_NO_TOP_DOWN; // compressed bitmaps are always bottom-up
+    if (header->planes != 1) return ERROR_WRONG_PLANES; // check if planes is 1
+    if (header->bitCount != BITS_PER_PIXEL && header->bitCount != BITS_PER_PIXEL_RLE4) return ERROR_BITS_PER_PIXEL; // is 8bpp or 4bpp bitmap
 
     // validate further based on BitmapCoreHeader or different header
-    return isBitmapCoreHeader(imgIn) ? validateCoreInfoHeader(imgIn) : validateInfoHeader(imgIn);
+    const uint8_t code = header->isCoreHeader ? validateCoreInfoHeader(header) : validateInfoHeader(header, compression);
+    if (code != SUCCESS_BITMAP_VALIDATION) return code;
+    return validatePixelDataSize(header, size, compression);
+}
+
+/*
+ * Validates if bitmap is valid for being compressed and parses its header into 'header'
+ * returns 'SUCCESS_BITMAP_VALIDATION' if success or 'ERROR_*' if not valid
+ */
+uint8_t parseBitmap(const uint8_t* imgIn, const long size, struct bitmapHeader* header) {
+    return parseBitmapWithCompression(imgIn, size, BI_RGB, header);
+}
+
+/*
+ * Validates if bitmap is a valid 24bpp or 32bpp bitmap for being quantised and compressed, the header is parsed once into 'header'
+ * returns 'SUCCESS_BITMAP_VALIDATION' if success or 'ERROR_*' if not valid
+ */
+uint8_t parseTrueColorBitmap(const uint8_t* imgIn, const long size, struct bitmapHeader* header) {
+    if (size < MIN_BITMAP_SIZE) return ERROR_TOO_SMALL;
+    parseBitmapHeader(imgIn, size, header);
+    if (header->fileType != BITMAP_FILE_TYPE) return ERROR_WRONG_FILE_TYPE;
+    if ((long)header->fileSize != size) return ERROR_INVALID_FILE_SIZE;
+
+    if (header->width <= 0) return ERROR_WRONG_WIDTH;
+    if (header->height == 0) return ERROR_WRONG_HEIGHT;
+    if (header->planes != 1) return ERROR_WRONG_PLANES;
+    if (header->bitCount != BITS_PER_PIXEL_24 && header->bitCount != BITS_PER_PIXEL_32) return ERROR_BITS_PER_PIXEL;
+    if (!isInfoHeaderSizeValid(header->infoHeaderSize)) return ERROR_INVALID_INFO_HEADER_SIZE;
+    if (header->compression != BI_RGB) return ERROR_ALREADY_COMPRESSED;
+
+    // true color bitmaps may have an (ignored) color palette behind the headers
+    if (header->offBits < BITMAPFILEHEADER_SIZE + header->infoHeaderSize) return ERROR_WRONG_OFF_BITS;
+    return validatePixelDataSize(header, size, BI_RGB);
+}
+
+/*
+ * Validates if bitmap is valid for being compressed
+ * returns 'SUCCESS_BITMAP_VALIDATION' if success or 'ERROR_*' if not valid
+ */
+uint8_t validateBitmap(const uint8_t* imgIn, const long size) {
+    struct bitmapHeader header;
+    return parseBitmap(imgIn, size, &header);
+}
+
+/*
+ * Validates if bitmap is a valid RLE_8 bitmap for being decompressed
+ * returns 'SUCCESS_BITMAP_VALIDATION' if success or 'ERROR_*' if not valid
+ */
+uint8_t validateRleBitmap(const uint8_t* imgIn, const long size) {
+    if (size < MIN_INFO_BITMAP_SIZE) return ERROR_TOO_SMALL;
+    // BitmapCoreHeader does not support compression
+    if (isBitmapCoreHeader(imgIn)) return ERROR_NOT_COMPRESSED;
+    // RLE_8 is only valid for 8bpp and RLE_4 for 4bpp
+    const uint32_t compression = getBitCount(imgIn) == BITS_PER_PIXEL_RLE4 ? BI_RLE4 : BI_RLE8;
+    struct bitmapHeader header;
+    return parseBitmapWithCompression(imgIn, size, compression, &header);
 }
 
 /*
@@ -154,17 +251,18 @@ uint32_t calcOffBitsForRle(const uint8_t* imgIn) {
 }
 
 /*
- * Creates a Buffer to write a compressed bitmap into
+ * Worst case size of the compressed pixel data
  */
-uint8_t* createOutputBufferForRle(const uint8_t* imgIn) {
-    const uint32_t width = getWidth(imgIn);
-    const uint32_t height = getHeight(imgIn);
-    const uint32_t offBits = calcOffBitsForRle(imgIn);
-    const uint8_t bitmapPadding = getBitmapPaddingFromWidth(width);
-    const uint32_t pixelDataSize = getFileSize(imgIn) - getOffBits(imgIn);
-    // (inPixelDataSize - bitmapPadding * height) * 2 + height * 2
-    const uint32_t maxSize = offBits + 2 * (pixelDataSize - bitmapPadding * height + height);
-    return malloc(maxSize);
+size_t getMaxPixelDataSizeForRle(const uint8_t* imgIn) {
+    return getMaxPixelDataSize(getWidth(imgIn), abs(getHeight(imgIn)));
+}
+
+/*
+ * Worst case size of 'width' x 'height' compressed pixels
+ */
+size_t getMaxPixelDataSize(const size_t width, const size_t height) {
+    // every pixel in encoded mode (2 bytes) plus end of line, for RLE_8 and RLE_4
+    return 2 * (width * height + height);
 }
 
 /*
@@ -188,11 +286,46 @@ uint8_t* moveToPixelData(uint8_t* imgIn) {
     return imgIn + getOffBits(imgIn);
 }
 
+/*
+ * Distance from one scan line to the scan line above it in the image
+ * top-down bitmaps store the top scan line first, so their stride is negative
+ */
+ptrdiff_t getBitmapStride(const struct bitmapHeader* header) {
+    const ptrdiff_t lineSize = getBitmapLineSize(header->width, header->bitCount);
+    return header->isTopDown ? -lineSize : lineSize;
+}
+
+/*
+ * Returns the bottom scan line of the bitmap, the first scan line of the compressed pixel data
+ */
+const uint8_t* getBottomLine(const uint8_t* imgIn, const struct bitmapHeader* header) {
+    const uint8_t* pixelData = imgIn + header->offBits;
+    if (!header->isTopDown) return pixelData;
+    // the bottom scan line is stored last
+    return pixelData + (size_t)(header->height - 1) * getBitmapLineSize(header->width, header->bitCount);
+}
+
+/*
+ * Write the height of a top-down bitmap as positive height, compressed bitmaps are always bottom-up
+ */
+static void writeBottomUpHeight(const uint8_t* imgIn, uint8_t* imgOut) {
+    const int32_t height = abs(getHeight(imgIn));
+    memcpy(imgOut + BITMAP_INDEX_HEIGHT, &height, 4);
+}
+
+/*
+ * Write compression RLE8 or RLE4 for 4bpp bitmaps
+ */
+static void writeCompressionForRle(const uint8_t* imgIn, uint8_t* imgOut) {
+    memset(imgOut + BITMAP_INDEX_COMPRESSION, getBitCount(imgIn) == BITS_PER_PIXEL_RLE4 ? BI_RLE4 : BI_RLE8, 1);
+    memset(imgOut + BITMAP_INDEX_COMPRESSION + 1, 0, 3);
+}
+
 /*
  * Write Bitmap Metadata
  * - copy BitmapFileHeader, BitmapInfoHeader and ColorPalette into imgOut
  * - if BitmapCoreHeader used convert first to BitmapInfoHeader and set default values
- * - set compression to RLE_8
+ * - set compression to RLE_8 (RLE_4 for 4bpp bitmaps)
  * - set offBits
  */
 uint32_t writeBitmapMetadataForRle(const uint8_t* imgIn, uint8_t* imgOut) {
@@ -231,27 +364,170 @@ uint32_t writeBitmapMetadataForRle(const uint8_t* imgIn, uint8_t* imgOut) {
     else {
         // Copy File Header, Information Header and Color Palette
         memcpy(imgOut, imgIn, inTopSize);
+        writeBottomUpHeight(imgIn, imgOut);
     }
 
     // write offBits
     memcpy(imgOut + BITMAP_INDEX_OFF_BITS, &outTopSize, 4);
-    // write compression RLE8
-    memset(imgOut + BITMAP_INDEX_COMPRESSION, BI_RLE8, 1);
-    memset(imgOut + BITMAP_INDEX_COMPRESSION + 1, 0, 3);
+    writeCompressionForRle(imgIn, imgOut);
 
     return outTopSize;
 }
 
 /*
- * Writes sizes after run-length-encoding
+ * Write the headers of a compressed bitmap without color palette
+ * only valid if no BitmapCoreHeader is used, so the color palette can be written unchanged from 'imgIn'
+ * returns the size of the headers
+ */
+uint32_t writeBitmapHeaderForRle(const uint8_t* imgIn, uint8_t* imgOut) {
+    const uint32_t headerSize = BITMAPFILEHEADER_SIZE + getInfoHeaderSize(imgIn);
+    memcpy(imgOut, imgIn, headerSize);
+    writeBottomUpHeight(imgIn, imgOut);
+    writeCompressionForRle(imgIn, imgOut);
+    return headerSize;
+}
+
+/*
+ * offBits of a bitmap compressed with delta escapes (see -D) around the background 'background'
+ * the color palette grows to 256 colors if it has no color for the background
+ */
+uint32_t calcOffBitsForDeltaRle(const uint8_t* imgIn, const uint8_t background) {
+    const uint32_t offBits = calcOffBitsForRle(imgIn);
+    const uint32_t headerSize = BITMAPFILEHEADER_SIZE + (isBitmapCoreHeader(imgIn) ? BITMAPINFOHEADER_SIZE : getInfoHeaderSize(imgIn));
+    return background < (offBits - headerSize) / 4 ? offBits : headerSize + MAX_INFO_COLOR_PALETTE_SIZE;
+}
+
+/*
+ * Write the metadata of a bitmap compressed with delta escapes (see -D)
+ * decoders leave skipped pixels at index 0, so the encoder swaps the background 'background' with index 0
+ * and the colors 0 and 'background' of the palette are swapped as well
+ * - writeBitmapMetadataForRle
+ * - extend the color palette to 256 colors (black) if it has no color for the background
+ * - swap the colors 0 and 'background', colors important is reset, as the order of the colors changed
+ * returns offBits
+ */
+uint32_t writeBitmapMetadataForDeltaRle(const uint8_t* imgIn, uint8_t* imgOut, const uint8_t background) {
+    const uint32_t headerSize = BITMAPFILEHEADER_SIZE + (isBitmapCoreHeader(imgIn) ? BITMAPINFOHEADER_SIZE : getInfoHeaderSize(imgIn));
+    uint32_t offBits = writeBitmapMetadataForRle(imgIn, imgOut);
+    if (background == 0) return offBits;
+
+    uint32_t colors = (offBits - headerSize) / 4;
+    if (background >= colors) {
+        memset(imgOut + offBits, 0, headerSize + MAX_INFO_COLOR_PALETTE_SIZE - offBits);
+        offBits = headerSize + MAX_INFO_COLOR_PALETTE_SIZE;
+        colors = 256;
+        memcpy(imgOut + BITMAP_INDEX_OFF_BITS, &offBits, 4);
+    }
+    uint8_t color[4];
+    memcpy(color, imgOut + headerSize, 4);
+    memcpy(imgOut + headerSize, imgOut + headerSize + 4 * background, 4);
+    memcpy(imgOut + headerSize + 4 * background, color, 4);
+    // a smaller colors used would hide the swapped color
+    memcpy(imgOut + BITMAP_INDEX_CLR_USED, &colors, 4);
+    memset(imgOut + BITMAP_INDEX_CLR_IMPORTANT, 0, 4);
+
+    return offBits;
+}
+
+/*
+ * Check if 'pixelDataSize' bytes of compressed pixel data behind 'offBits' fit into a bitmap file
+ * the compressed pixel data of a large bitmap of noise may not fit even though its uncompressed pixel data does
+ */
+uint8_t isRleSizeValid(const uint32_t offBits, const size_t pixelDataSize) {
+    return pixelDataSize <= MAX_BITMAP_FILE_SIZE - offBits;
+}
+
+/*
+ * Writes sizes after run-length-encoding, 'pixelDataSize' has to be checked with 'isRleSizeValid'
  * - file size
  * - size image
  */
-uint32_t writeBitmapSizesForRle(uint8_t* imgOut, const uint32_t offBits, const uint32_t pixelDataSize) {
+uint32_t writeBitmapSizesForRle(uint8_t* imgOut, const uint32_t offBits, const size_t pixelDataSize) {
     const uint32_t outSize = offBits + pixelDataSize;
+    const uint32_t sizeImage = pixelDataSize;
 
     memcpy(imgOut + BITMAP_INDEX_FILE_SIZE, &outSize, 4);
-    memcpy(imgOut + BITMAP_INDEX_SIZE_IMAGE, &pixelDataSize, 4);
+    memcpy(imgOut + BITMAP_INDEX_SIZE_IMAGE, &sizeImage, 4);
 
     return outSize;
 }
+
+/*
+ * Creates a zeroed Buffer to write a decompressed bitmap into
+ */
+uint8_t* createOutputBufferForDecode(const uint8_t* imgIn) {
+    const size_t height = getHeight(imgIn);
+    return calloc(getOffBits(imgIn) + getBitmapLineSize(getWidth(imgIn), getBitCount(imgIn)) * height, 1);
+}
+
+/*
+ * Write Bitmap Metadata of a decompressed bitmap
+ * - copy BitmapFileHeader, BitmapInfoHeader and ColorPalette into imgOut
+ * - set compression to RGB
+ * - set file size and size image
+ * returns the size of the decompressed bitmap
+ */
+uint32_t writeBitmapMetadataForDecode(const uint8_t* imgIn, uint8_t* imgOut) {
+    const uint32_t offBits = getOffBits(imgIn);
+    const uint32_t pixelDataSize = getBitmapLineSize(getWidth(imgIn), getBitCount(imgIn)) * getHeight(imgIn);
+
+    memcpy(imgOut, imgIn, offBits);
+    memset(imgOut + BITMAP_INDEX_COMPRESSION, BI_RGB, 4);
+    return writeBitmapSizesForRle(imgOut, offBits, pixelDataSize);
+}
+
+/*
+ * Returns the description of the validation error 'code'
+ */
+char* getValidationErrorMessage(const uint8_t code) {
+    switch (code) {
+    case ERROR_TOO_SMALL:
+        return "Bitmap file is too small";
+    case ERROR_INVALID_FILE_SIZE:
+        return "The bitmap declares a wrong file size";
+    case ERROR_WRONG_FILE_TYPE:
+        return "The file is not a bitmap";
+    case ERROR_WRONG_WIDTH:
+        return "Something is wrong with the specified width of the bitmap";
+    case ERROR_WRONG_HEIGHT:
+        return "Something is wrong with the specified height of the bitmap";
+    case ERROR_ALREADY_COMPRESSED:
+        return "The Bitmap was already compressed, please use an uncompressed bitmap for compression";
+    case ERROR_BITS_PER_PIXEL:
+        return "Bits per pixel should be 8 or 4 (24 and 32 are quantised to 8)";
+    case ERROR_WRONG_PLANES:
+        return "Invalid plane number in bitmap";
+    case ERROR_INVALID_INFO_HEADER_SIZE:
+        return "Invalid information header size";
+    case ERROR_CLR_USED:
+        return "Invalid number of colors used";
+    case ERROR_CLR_IMPORTANT:
+        return "Invalid number of important colors used";
+    case ERROR_WRONG_OFF_BITS:
+        return "Invalid off bits number";
+    case ERROR_NO_TOP_DOWN:
+        return "Compressed Bitmaps can't be top down";
+    case ERROR_INVALID_COLOR_PALETTE_SIZE:
+        return "Check your Bitmap, something is wrong with the size of the color palette";
+    case ERROR_NOT_COMPRESSED:
+        return "The Bitmap is not RLE_8 compressed, please use a compressed bitmap for decompression";
+    case ERROR_CORRUPT_RLE_DATA:
+        return "The compressed pixel data exceeds the bitmap";
+    case ERROR_NO_MEMORY:
+        return "Error while allocating memory";
+    case ERROR_INVALID_ARGUMENT:
+        return "Invalid argument";
+    case ERROR_UNSUPPORTED_VERSION:
+        return "The selected version does not exist or is not supported by this CPU";
+    case ERROR_TOO_LARGE:
+        return "The bitmap exceeds the maximum bitmap file size of 4 GiB";
+    case ERROR_NOT_INDEXABLE:
+        return "The scan lines of the compressed pixel data can't be told apart (delta escapes or missing end of line)";
+    case ERROR_BUFFER_TOO_SMALL:
+        return "The buffer is too small for the updated bitmap";
+    case ERROR_INVALID_ROW_INDEX:
+        return "The row index doesn't belong to the compressed bitmap";
+    default:
+        return "Something unexpected happened";
+    }
+}
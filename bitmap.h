@@ -10,6 +10,8 @@
 
  // Includes
 #include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
 
 // Bitmap File Header
 #define BITMAPFILEHEADER_SIZE 14
@@ -32,20 +34,30 @@
 // Compression Mode
 #define BI_RGB 0
 #define BI_RLE8 1
+#define BI_RLE4 2
 
 // Escape Bytes
 #define END_OF_LINE_BYTE 0
 #define END_OF_BITMAP_BYTE 1
+#define DELTA_BYTE 2
 
 // PixelData
 #define MIN_PIXEL_DATA_SIZE 1 // 1 equals one pixel index = 1 byte
 #define BITS_PER_PIXEL 8
+#define BITS_PER_PIXEL_RLE4 4
+#define BITS_PER_PIXEL_24 24 // quantised to 8bpp before compression
+#define BITS_PER_PIXEL_32 32
 
 // Off Bits
 #define MIN_INFO_OFF_BITS (BITMAPFILEHEADER_SIZE + BITMAPINFOHEADER_SIZE + MIN_INFO_COLOR_PALETTE_SIZE)
 #define MIN_CORE_OFF_BITS (BITMAPFILEHEADER_SIZE + BITMAPCOREHEADER_SIZE + MIN_CORE_COLOR_PALETTE_SIZE)
 #define MAX_INFO_OFF_BITS (BITMAPFILEHEADER_SIZE + BITMAPV5HEADER_SIZE + MAX_INFO_COLOR_PALETTE_SIZE)
 #define MAX_CORE_OFF_BITS (BITMAPFILEHEADER_SIZE + BITMAPCOREHEADER_SIZE + MAX_CORE_COLOR_PALETTE_SIZE)
+// a quantised bitmap has a BitmapInfoHeader and the 256 colors of the 3-3-2 palette
+#define QUANTISED_OFF_BITS (BITMAPFILEHEADER_SIZE + BITMAPINFOHEADER_SIZE + MAX_INFO_COLOR_PALETTE_SIZE)
+
+// every size of the file header is 32 bit, which bounds width x height of the pixel data
+#define MAX_BITMAP_FILE_SIZE UINT32_MAX
 
 // Min Bitmap Sizes
 #define MIN_INFO_BITMAP_SIZE (MIN_INFO_OFF_BITS + MIN_PIXEL_DATA_SIZE)
@@ -87,27 +99,185 @@
 #define ERROR_WRONG_OFF_BITS 12
 #define ERROR_NO_TOP_DOWN 13
 #define ERROR_INVALID_COLOR_PALETTE_SIZE 14
+#define ERROR_NOT_COMPRESSED 15
+#define ERROR_CORRUPT_RLE_DATA 16
+#define ERROR_NO_MEMORY 17
+#define ERROR_INVALID_ARGUMENT 18
+#define ERROR_UNSUPPORTED_VERSION 19
+#define ERROR_TOO_LARGE 20
+#define ERROR_NOT_INDEXABLE 21
+#define ERROR_BUFFER_TOO_SMALL 22
+#define ERROR_INVALID_ROW_INDEX 23
+
+// Versions
+#define VERSION_SSE2 0
+#define VERSION_AVX2 4
+#define VERSION_AVX512 5
+#define VERSION_BOUNDARY 6
+#define VERSION_OPTIMAL 7
+
+// Header Descriptor, parsed once instead of reading every field with its getter
+struct bitmapHeader {
+    uint16_t fileType;
+    uint32_t fileSize;
+    uint32_t offBits;
+    uint32_t infoHeaderSize;
+    uint8_t isCoreHeader;
+    int32_t width;
+    int32_t height; // always positive, a negative height in the file sets 'isTopDown'
+    uint8_t isTopDown;
+    uint16_t planes;
+    uint16_t bitCount;
+    uint32_t compression;
+    uint32_t clrUsed;
+    uint32_t clrImportant;
+    uint32_t colorPaletteSize;
+};
 
 // Bitmap Getter
 int32_t getWidth(const uint8_t* imgIn);
 int32_t getHeight(const uint8_t* imgIn);
 uint32_t getOffBits(const uint8_t* imgIn);
+uint32_t getFileSize(const uint8_t* imgIn);
+uint16_t getBitCount(const uint8_t* imgIn);
 
 
 // Functions
 uint32_t getColorPaletteSize(const uint8_t* imgIn);
-uint8_t getBitmapPaddingFromWidth(const uint8_t width);
+uint8_t getBitmapPaddingFromWidth(const size_t width);
+size_t getBitmapLineSize(const size_t width, const uint16_t bitCount);
+void parseBitmapHeader(const uint8_t* imgIn, const long size, struct bitmapHeader* header);
+uint8_t parseBitmap(const uint8_t* imgIn, const long size, struct bitmapHeader* header);
+uint8_t parseTrueColorBitmap(const uint8_t* imgIn, const long size, struct bitmapHeader* header);
 uint8_t validateBitmap(const uint8_t* imgIn, const long size);
-uint8_t* createOutputBufferForRle(const uint8_t* imgIn);
+uint8_t validateRleBitmap(const uint8_t* imgIn, const long size);
+uint32_t calcOffBitsForRle(const uint8_t* imgIn);
+size_t getMaxPixelDataSizeForRle(const uint8_t* imgIn);
+size_t getMaxPixelDataSize(const size_t width, const size_t height);
 uint32_t writeBitmapMetadataForRle(const uint8_t* imgIn, uint8_t* imgOut);
-uint32_t writeBitmapSizesForRle(uint8_t* imgOut, const uint32_t offBits, const uint32_t pixelDataSize);
+uint32_t writeBitmapHeaderForRle(const uint8_t* imgIn, uint8_t* imgOut);
+uint32_t calcOffBitsForDeltaRle(const uint8_t* imgIn, const uint8_t background);
+uint32_t writeBitmapMetadataForDeltaRle(const uint8_t* imgIn, uint8_t* imgOut, const uint8_t background);
+uint8_t isRleSizeValid(const uint32_t offBits, const size_t pixelDataSize);
+uint32_t writeBitmapSizesForRle(uint8_t* imgOut, const uint32_t offBits, const size_t pixelDataSize);
+uint8_t* createOutputBufferForDecode(const uint8_t* imgIn);
+uint32_t writeBitmapMetadataForDecode(const uint8_t* imgIn, uint8_t* imgOut);
 uint8_t* moveToPixelData(uint8_t* imgIn);
+ptrdiff_t getBitmapStride(const struct bitmapHeader* header);
+const uint8_t* getBottomLine(const uint8_t* imgIn, const struct bitmapHeader* header);
 uint8_t isBitmapCoreHeader(const uint8_t* imgIn);
+char* getValidationErrorMessage(const uint8_t code);
 
 // Bitmap Compression Functions
-size_t bmpRle(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleData);
-size_t bmpRleV1(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleData);
-size_t bmpRleV2(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleData);
-size_t bmpRleEncodeV3(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleData);
+size_t bmpRle(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleV1(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleV2(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleEncodeV3(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleAvx2(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleAvx512(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleBoundary(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleOptimal(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRle4(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleDelta(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleDeltaBackground(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, const uint8_t background, uint8_t* rleData);
+uint8_t getDominantPixel(const uint8_t* imgIn, const size_t width, const size_t height, const ptrdiff_t stride);
+size_t bmpRleInterFrame(const uint8_t* imgIn, const uint8_t* reference, size_t width, size_t height, ptrdiff_t stride,
+    ptrdiff_t referenceStride, uint8_t* rleData);
+size_t bmpRleQuantise24(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+size_t bmpRleQuantise32(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+uint32_t writeBitmapMetadataForQuantisedRle(const uint8_t* imgIn, uint8_t* imgOut);
+size_t bmpRleBoundaryWriteLine(const uint8_t* line, size_t width, uint8_t* rleData);
+
+// Bitmap Measure Functions (exact compressed size without writing)
+size_t bmpRleBoundaryMeasure(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, size_t* lineSizes);
+size_t bmpRleBoundaryMeasureLine(const uint8_t* line, size_t width);
+
+// Bitmap Decompression Functions
+uint8_t bmpRleDecode(const uint8_t* rleData, size_t rleSize, size_t width, size_t height, uint8_t* imgOut);
+uint8_t bmpRle4Decode(const uint8_t* rleData, size_t rleSize, size_t width, size_t height, uint8_t* imgOut);
+uint8_t bmpRleIndexRows(const uint8_t* rleData, size_t rleSize, size_t height, size_t* rowOffsets);
+
+// Row Index (sidecar of the scan line offsets of a compressed bitmap, see bmp_rle_index.c)
+#define ROW_INDEX_MAGIC "RIDX"
+#define ROW_INDEX_HEADER_SIZE 8 // magic and height
+size_t getRowIndexSize(const size_t height);
+void writeRowIndex(const size_t* rowOffsets, const size_t height, uint8_t* index);
+uint8_t readRowIndex(const uint8_t* index, const size_t indexSize, const size_t height, const size_t rleSize, size_t* rowOffsets);
+uint8_t bmpRleDecodeRows(const uint8_t* rleData, const size_t* rowOffsets, size_t width, size_t firstRow, size_t rowCount, uint8_t* imgOut,
+    size_t threadCount);
+
+// Version Dispatch
+// 'imgIn' is the bottom scan line, 'stride' the distance to the scan line above it (negative for top-down bitmaps)
+typedef size_t(*bmpRleFunction)(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData);
+typedef size_t(*bmpRleMeasureFunction)(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, size_t* lineSizes);
+extern const long amountOfVersions;
+bmpRleFunction getCompressionFunction(const long versionNumber);
+bmpRleMeasureFunction getMeasureFunction(const long versionNumber);
+uint8_t isVersionSupported(const long versionNumber);
+long getWidestSupportedVersion();
+
+// Duplicate Scan Line Reuse
+size_t bmpRleDedup(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData, bmpRleFunction bmpRle);
+
+// Parallel Compression
+size_t bmpRleParallel(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData, bmpRleFunction bmpRle, size_t threadCount, const size_t* lineSizes);
+
+// Streaming Compression
+#define TILE_OUTPUT_SIZE ((size_t)64 << 20) // worst case size of the compressed pixel data of one tile
+struct tiledJob {
+    const uint8_t* imgIn; // bottom scan line
+    size_t width;
+    size_t height;
+    ptrdiff_t stride;
+    bmpRleFunction bmpRle;
+    size_t threadCount;
+    const size_t* lineSizes; // NULL or the exact size of every compressed scan line
+    size_t* rowOffsets; // NULL or filled with the offset of every compressed scan line (height + 1 entries)
+};
+void bmpRleStream(FILE* in, FILE* out);
+size_t bmpRleTiled(const struct tiledJob* job, uint8_t* outHeader, const uint32_t offBits, FILE* out);
+
+// Benchmark
+struct benchmarkOptions {
+    long runs; // measured runs
+    long warmupRuns; // discarded runs before measuring
+    long cpu; // CPU the benchmark is pinned to or -1
+    char isCold; // flush input and output from the caches before every run
+    char isJson;
+    char isCounting; // report hardware performance counters
+};
+size_t bmpRleBenchmark(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData, size_t rleDataSize,
+    bmpRleFunction bmpRle, size_t threadCount, const size_t* lineSizes, const struct benchmarkOptions* options, const char* label, FILE* report);
+
+// Autotuning
+#define CONTENT_CLASS_COUNT 4
+struct tuningProfile {
+    long versions[CONTENT_CLASS_COUNT]; // fastest version of every content class on this host
+};
+double getEqualNeighbourRatio(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride);
+long selectTunedVersion(const struct tuningProfile* profile, const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride);
+void getDefaultProfileFile(char* profileFile, size_t size, char isCreatingDirectory);
+uint8_t readTuningProfile(const char* profileFile, struct tuningProfile* profile);
+void bmpRleTune(const char* profileFile);
+
+// Batch Compression
+size_t bmpRleBatch(char** inputFiles, size_t fileCount, const char* outputDirectory, long versionNumber, const struct tuningProfile* profile,
+    char isDelta, size_t threadCount);
+char** readManifest(const char* manifestFile, char** inputFiles, size_t* fileCount);
+
+// Encode Daemon (one message per request and reply, the bitmaps are passed as memfd descriptors)
+#define DAEMON_MAGIC 0x31515242 // "BRQ1"
+struct daemonRequest {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t size; // bytes of the bitmap in the memfd, which is sealed against shrinking and writing
+};
+struct daemonReply {
+    uint32_t code; // 'SUCCESS_BITMAP_VALIDATION' or an 'ERROR_*' code, only a success carries the memfd of the compressed bitmap
+    uint32_t reserved;
+    uint64_t size;
+};
+void bmpRleDaemon(const char* socketFile, long versionNumber, size_t threadCount);
+void bmpRleConnect(const char* socketFile, const char* inputFile, const char* outputFile, long runs);
 
 #endif //TEAM121_BITMAP_H
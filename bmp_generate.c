@@ -0,0 +1,296 @@
+/*
+ * Generator of synthetic 8bpp bitmaps for benchmarks
+ * Scan lines are random runs with a geometric run length distribution, disturbed by noise,
+ * or adversarial patterns driving the encoders onto their worst case token paths
+ * Every header format accepted by 'validateBitmap' can be written, at any size and palette size
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h> // log
+#include "bitmap.h"
+#include "util.h"
+
+// content of the scan lines
+#define PATTERN_RUNS 0 // random runs, see -r and -n
+#define PATTERN_ALTERNATE1 1 // abab..., every pixel differs, longest absolute mode sequences
+#define PATTERN_ALTERNATE2 2 // aabb..., runs of 2 are merged into absolute mode
+#define PATTERN_RUNS3 3 // aaabbb..., the shortest runs written in encoded mode, one token per 3 pixels
+#define PATTERN_RUN3_SINGLE 4 // aaab..., runs of 3 interrupted by single pixels
+#define PATTERN_RUNS256 5 // runs of 256, split at the 255 limit into a run and a single pixel
+
+struct generatorOptions {
+    long width;
+    long height;
+    uint32_t infoHeaderSize;
+    long paletteSize;
+    double meanRunLength;
+    double noiseRatio;
+    int pattern;
+    uint64_t seed;
+    char isDirtyPadding; // fill the padding bytes with random values instead of zeros
+    char isTopDown; // negative height, the scan lines are stored from the top, so the image equals the bottom-up one
+};
+
+static uint64_t nextRandom(uint64_t* state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static double nextUniform(uint64_t* state) {
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Random palette index, different from 'previous' if the palette has more than one color
+ */
+static uint8_t nextPixel(uint64_t* state, const long paletteSize, const int previous) {
+    uint8_t pixel;
+    do {
+        pixel = nextRandom(state) % paletteSize;
+    } while (paletteSize > 1 && pixel == previous);
+    return pixel;
+}
+
+/*
+ * Fill 'line' with 'width' pixels of 'options->pattern'
+ */
+static void generateLine(uint8_t* line, const struct generatorOptions* options, uint64_t* state) {
+    const long width = options->width;
+    const int runLengths[] = { 0, 1, 2, 3, 0, 256 };
+
+    if (options->pattern == PATTERN_RUNS) {
+        long x = 0;
+        int previous = -1;
+        while (x < width) {
+            // geometric distribution with mean 'meanRunLength'
+            long length = 1;
+            if (options->meanRunLength > 1.0) {
+                length += (long)(log(1.0 - nextUniform(state)) / log(1.0 - 1.0 / options->meanRunLength));
+            }
+            const uint8_t pixel = nextPixel(state, options->paletteSize, previous);
+            for (; length > 0 && x < width; length--) {
+                line[x++] = pixel;
+            }
+            previous = pixel;
+        }
+        for (x = 0; x < width; x++) {
+            if (nextUniform(state) < options->noiseRatio) line[x] = nextRandom(state) % options->paletteSize;
+        }
+        return;
+    }
+
+    int previous = -1;
+    uint8_t pixel = 0;
+    for (long x = 0; x < width; x++) {
+        long position;
+        if (options->pattern == PATTERN_RUN3_SINGLE) {
+            // three equal pixels and a single one
+            position = x % 4 == 0 || x % 4 == 3;
+        }
+        else {
+            position = x % runLengths[options->pattern] == 0;
+        }
+        if (position) {
+            pixel = nextPixel(state, options->paletteSize, previous);
+            previous = pixel;
+        }
+        line[x] = pixel;
+    }
+}
+
+/*
+ * Write file header, information header and color palette, returns offBits
+ */
+static uint32_t writeHeader(FILE* out, const struct generatorOptions* options) {
+    uint8_t header[MAX_INFO_OFF_BITS] = { 0 };
+    const uint8_t isCoreHeader = options->infoHeaderSize == BITMAPCOREHEADER_SIZE;
+    const uint32_t colorSize = isCoreHeader ? 3 : 4;
+    const uint32_t offBits = BITMAPFILEHEADER_SIZE + options->infoHeaderSize + options->paletteSize * colorSize;
+    const uint32_t lineSize = getBitmapLineSize(options->width, BITS_PER_PIXEL);
+    const uint32_t sizeImage = lineSize * options->height; // at most 4 GiB, checked in main
+    const uint32_t fileSize = offBits + sizeImage;
+    const uint16_t fileType = BITMAP_FILE_TYPE;
+    const uint16_t planes = 1;
+    const uint16_t bitCount = BITS_PER_PIXEL;
+
+    memcpy(header + BITMAP_INDEX_FILE_TYPE, &fileType, 2);
+    memcpy(header + BITMAP_INDEX_FILE_SIZE, &fileSize, 4);
+    memcpy(header + BITMAP_INDEX_OFF_BITS, &offBits, 4);
+    memcpy(header + BITMAP_INDEX_INFO_SIZE, &options->infoHeaderSize, 4);
+    if (isCoreHeader) {
+        const uint16_t width = options->width;
+        const uint16_t height = options->height;
+        memcpy(header + BITMAP_INDEX_CORE_WIDTH, &width, 2);
+        memcpy(header + BITMAP_INDEX_CORE_HEIGHT, &height, 2);
+        memcpy(header + BITMAP_INDEX_CORE_PLANES, &planes, 2);
+        memcpy(header + BITMAP_INDEX_CORE_BIT_COUNT, &bitCount, 2);
+    }
+    else {
+        const int32_t width = options->width;
+        const int32_t height = options->isTopDown ? -options->height : options->height;
+        const uint32_t compression = BI_RGB;
+        const uint32_t clrUsed = options->paletteSize;
+        memcpy(header + BITMAP_INDEX_WIDTH, &width, 4);
+        memcpy(header + BITMAP_INDEX_HEIGHT, &height, 4);
+        memcpy(header + BITMAP_INDEX_PLANES, &planes, 2);
+        memcpy(header + BITMAP_INDEX_BIT_COUNT, &bitCount, 2);
+        memcpy(header + BITMAP_INDEX_COMPRESSION, &compression, 4);
+        memcpy(header + BITMAP_INDEX_SIZE_IMAGE, &sizeImage, 4);
+        memcpy(header + BITMAP_INDEX_CLR_USED, &clrUsed, 4);
+    }
+
+    // gray ramp, so the content stays visible in a viewer
+    uint8_t* palette = header + BITMAPFILEHEADER_SIZE + options->infoHeaderSize;
+    for (long i = 0; i < options->paletteSize; i++) {
+        const uint8_t gray = options->paletteSize > 1 ? i * 255 / (options->paletteSize - 1) : 0;
+        memset(palette + i * colorSize, gray, 3);
+    }
+
+    if (fwrite(header, offBits, 1, out) != 1) throwSystemError("Error while writing output file");
+    return offBits;
+}
+
+static void printGeneratorUsage() {
+    char* help =
+        "bmpGenerate\n\n"
+        "\033[1mNAME\033[0m\n"
+        "\tbmpGenerate - write a synthetic 8bpp bitmap for benchmarks\n\n"
+        "\033[1mSYNOPSIS\033[0m\n"
+        "\tbmpGenerate [-W=<WIDTH>] [-H=<HEIGHT>] [-f=<HEADER>] [-p=<PALETTE_SIZE>] [-r=<MEAN_RUN_LENGTH>] [-n=<NOISE_RATIO>]\n"
+        "\t\t[-a=<PATTERN>] [-s=<SEED>] [-g] [-t] [-o=<OUTPUT_FILE_PATH>] [-h]\n\n"
+        "\033[1mOPTIONS\033[0m\n"
+        "\t-W, -H\tWidth and height (default 3840x2160), the bitmap file is limited to 4 GiB (65535x65535 with core header),\n"
+        "\t\twidth % 4 sets the padding of every scan line\n\n"
+        "\t-f\tHeader format: core, info, v4 or v5 (default info)\n\n"
+        "\t-p\tPalette size in [1,256] (default 256)\n\n"
+        "\t-r\tMean run length of the geometric run length distribution (default 4)\n\n"
+        "\t-n\tRatio of pixels replaced by random noise in [0,1] (default 0)\n\n"
+        "\t-a\tAdversarial pattern instead of random runs:\n"
+        "\t\talternate1 (abab), alternate2 (aabb), runs3 (aaabbb), run3single (aaab), runs256\n\n"
+        "\t-s\tSeed of the random generator (default 1)\n\n"
+        "\t-g\tFill the padding bytes with garbage instead of zeros\n\n"
+        "\t-t\tTop-down bitmap with the same image as without -t (not for core headers)\n\n"
+        "\t-o\tPath to output file (default ./generated.bmp)\n\n"
+        "\033[1mSAMPLE EXECUTIONS\033[0m\n\n"
+        "\t./bmpGenerate -W 7680 -H 4320 -r 12 -p 16 -n 0.02 -o 8k.bmp\n"
+        "\t./bmpGenerate -W 3841 -H 2160 -f core -a alternate2 -g -o worst.bmp\n\n";
+    fprintf(stdout, "%s", help);
+}
+
+static uint32_t getInfoHeaderSizeByName(const char* name) {
+    if (strcmp(name, "core") == 0) return BITMAPCOREHEADER_SIZE;
+    if (strcmp(name, "info") == 0) return BITMAPINFOHEADER_SIZE;
+    if (strcmp(name, "v4") == 0) return BITMAPV4HEADER_SIZE;
+    if (strcmp(name, "v5") == 0) return BITMAPV5HEADER_SIZE;
+    throwError("Header format(-f) should be core, info, v4 or v5");
+    return 0;
+}
+
+static int getPatternByName(const char* name) {
+    const char* names[] = { "runs", "alternate1", "alternate2", "runs3", "run3single", "runs256" };
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (strcmp(name, names[i]) == 0) return i;
+    }
+    throwError("Unknown pattern(-a)");
+    return 0;
+}
+
+static double getNumberAsDouble(const char* numberPtr) {
+    char* numberEndPtr;
+    const double number = strtod(numberPtr, &numberEndPtr);
+    return *numberEndPtr != '\0' || numberEndPtr == numberPtr ? -1.0 : number;
+}
+
+int main(int argc, char** argv) {
+    struct generatorOptions options = { 3840, 2160, BITMAPINFOHEADER_SIZE, 256, 4.0, 0.0, PATTERN_RUNS, 1, 0, 0 };
+    char* outputFile = "generated.bmp";
+    int opt;
+    while ((opt = getopt(argc, argv, "W:H:f:p:r:n:a:s:gto:h")) != -1) {
+        switch (opt) {
+        case 'W':
+            options.width = getNumberAsLong(optarg);
+            break;
+        case 'H':
+            options.height = getNumberAsLong(optarg);
+            break;
+        case 'f':
+            options.infoHeaderSize = getInfoHeaderSizeByName(optarg);
+            break;
+        case 'p':
+            options.paletteSize = getNumberAsLong(optarg);
+            break;
+        case 'r':
+            options.meanRunLength = getNumberAsDouble(optarg);
+            break;
+        case 'n':
+            options.noiseRatio = getNumberAsDouble(optarg);
+            break;
+        case 'a':
+            options.pattern = getPatternByName(optarg);
+            break;
+        case 's':
+            options.seed = getNumberAsLong(optarg);
+            break;
+        case 'g':
+            options.isDirtyPadding = 1;
+            break;
+        case 't':
+            options.isTopDown = 1;
+            break;
+        case 'o':
+            outputFile = optarg;
+            break;
+        case 'h':
+            printGeneratorUsage();
+            return 0;
+        default:
+            printGeneratorUsage();
+            throwError("\nAn unrecognized option was used!");
+        }
+    }
+    if (optind < argc) throwError("Too many arguments");
+    if (options.width < 1) throwError("Width(-W) should be at least 1");
+    if (options.height < 1) throwError("Height(-H) should be at least 1");
+    if (options.infoHeaderSize == BITMAPCOREHEADER_SIZE && (options.width > UINT16_MAX || options.height > UINT16_MAX)) {
+        throwError("Width(-W) and height(-H) of a core header(-f core) should be at most 65535");
+    }
+    if (options.infoHeaderSize == BITMAPCOREHEADER_SIZE && options.isTopDown) throwError("Top-down(-t) is not supported for core headers");
+    if ((uint64_t)getBitmapLineSize(options.width, BITS_PER_PIXEL) * options.height + MAX_INFO_OFF_BITS > MAX_BITMAP_FILE_SIZE) {
+        throwError("The bitmap exceeds the maximum bitmap file size of 4 GiB");
+    }
+    if (options.paletteSize < 1 || options.paletteSize > 256) throwError("Palette size(-p) should be in [1,256]");
+    if (options.meanRunLength < 1.0) throwError("Mean run length(-r) should be at least 1");
+    if (options.noiseRatio < 0.0 || options.noiseRatio > 1.0) throwError("Noise ratio(-n) should be in [0,1]");
+    if (options.seed == 0 || options.seed == (uint64_t)-1) throwError("Seed(-s) should be a positive number");
+
+    FILE* out = fopen(outputFile, "wb");
+    if (out == NULL) throwSystemError("Error while opening output file");
+    const uint32_t offBits = writeHeader(out, &options);
+
+    // one scan line at a time, so gigapixel bitmaps don't need the whole image in memory
+    // the scan lines are generated from the bottom, a top-down bitmap stores the bottom scan line last
+    const uint32_t lineSize = getBitmapLineSize(options.width, BITS_PER_PIXEL);
+    uint8_t* line = calloc(lineSize, 1);
+    if (line == NULL) throwSystemError("Error while allocating memory");
+    uint64_t state = options.seed;
+    for (long i = 0; i < options.height; i++) {
+        generateLine(line, &options, &state);
+        for (uint32_t x = options.width; x < lineSize; x++) {
+            line[x] = options.isDirtyPadding ? nextRandom(&state) : 0;
+        }
+        if (options.isTopDown && fseek(out, offBits + (long)(options.height - 1 - i) * lineSize, SEEK_SET) != 0) {
+            throwSystemError("Error while writing output file");
+        }
+        if (fwrite(line, lineSize, 1, out) != 1) throwSystemError("Error while writing output file");
+    }
+
+    free(line);
+    if (fclose(out) != 0) throwSystemError("Error while writing output file");
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * SIMD Optimized Implementation of RLE_4 (4bpp bitmaps)
+ * Two pixels share one byte (high nibble first), a run in encoded mode [count pixel1pixel2]
+ * repeats a pair of pixels, so pixel k is compared with pixel k + 2
+ * The comparison works on the packed bytes: pixel k + 2 is the same nibble of the next byte
+ */
+
+#include <stdint.h> // uint
+#include <memory.h> // memcpy
+#include <emmintrin.h> // SIMD
+#include "bitmap.h"
+
+// pixels compared per boundary word
+#define BOUNDARY_WORD_SIZE 64
+// runs shorter than this are cheaper inside an absolute block (2 pixels per byte)
+#define MIN_RLE4_RUN 8
+// even, so a split run continues with the same pair of pixels
+#define MAX_RLE4_RUN 254
+// multiple of 4, so the absolute block needs no padding byte
+#define MAX_RLE4_ABSOLUTE_CHUNK 252
+
+static inline uint8_t getPixel4(const uint8_t* line, const size_t index) {
+    return index % 2 == 0 ? line[index / 2] >> 4 : line[index / 2] & 0x0F;
+}
+
+/*
+ * Returns the pair run boundaries of pixels [0,63] compared with [2,65]
+ * bit k is set if pixel k differs from pixel k + 2
+ */
+static inline uint64_t getPairBoundaryWord(const uint8_t* bytePointer) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i highMask = _mm_set1_epi8((char)0xF0);
+    const __m128i lowMask = _mm_set1_epi8(0x0F);
+    uint64_t equalMask = 0;
+
+    for (int i = 0; i < BOUNDARY_WORD_SIZE / 2; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i_u*)(bytePointer + i));
+        __m128i bytes2 = _mm_loadu_si128((const __m128i_u*)(bytePointer + i + 1));
+        __m128i changed = _mm_xor_si128(bytes, bytes2);
+        // one byte per pixel: equal high nibbles are even pixels, equal low nibbles odd pixels
+        __m128i highEqual = _mm_cmpeq_epi8(_mm_and_si128(changed, highMask), zero);
+        __m128i lowEqual = _mm_cmpeq_epi8(_mm_and_si128(changed, lowMask), zero);
+        equalMask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_unpacklo_epi8(highEqual, lowEqual)) << (2 * i);
+        equalMask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_unpackhi_epi8(highEqual, lowEqual)) << (2 * i + 16);
+    }
+    return ~equalMask;
+}
+
+/*
+ * Returns the pair run boundaries of the last pixels [base, width) of a scan line,
+ * pixel width - 2 is always a boundary as the last run ends with the scan line
+ */
+static inline uint64_t getLastPairBoundaryWord(const uint8_t* line, const size_t base, const size_t width) {
+    uint64_t boundaries = (uint64_t)1 << (width - 2 - base);
+    for (size_t k = base; k + 2 < width; k++) {
+        boundaries |= (uint64_t)(getPixel4(line, k) != getPixel4(line, k + 2)) << (k - base);
+    }
+    return boundaries;
+}
+
+/*
+ * Write pixels [start, end) of runs shorter than 'MIN_RLE4_RUN'
+ */
+static uint8_t* writeShortRuns4(const uint8_t* line, size_t start, const size_t end, uint8_t* outPixelPointer) {
+    while (end - start > 2) {
+        // absolute mode [00 count pixel1pixel2 ...] padded to 2 bytes
+        const uint8_t chunk = end - start > 255 ? MAX_RLE4_ABSOLUTE_CHUNK : end - start;
+        const uint8_t bytes = (chunk + 1) / 2;
+        *outPixelPointer++ = 0;
+        *outPixelPointer++ = chunk;
+        if (start % 2 == 0) {
+            // pixel pairs are aligned with the input bytes
+            memcpy(outPixelPointer, line + start / 2, bytes);
+            if (chunk % 2 == 1) outPixelPointer[bytes - 1] &= 0xF0;
+        }
+        else {
+            for (uint8_t k = 0; k < chunk; k += 2) {
+                outPixelPointer[k / 2] = getPixel4(line, start + k) << 4 | (k + 1 < chunk ? getPixel4(line, start + k + 1) : 0);
+            }
+        }
+        outPixelPointer += bytes;
+        if (bytes % 2 == 1) {
+            // 2-byte alignment
+            *outPixelPointer++ = 0;
+        }
+        start += chunk;
+    }
+    if (end > start) {
+        // encoded mode [count pixel1pixel2] for 1 or 2 pixels
+        *outPixelPointer++ = end - start;
+        *outPixelPointer++ = getPixel4(line, start) << 4 | (end - start == 2 ? getPixel4(line, start + 1) : 0);
+    }
+    return outPixelPointer;
+}
+
+/*
+ * Write a run of 'count' pixels repeating the pair starting at pixel 'start'
+ */
+static uint8_t* writeRun4(const uint8_t* line, const size_t start, size_t count, uint8_t* outPixelPointer) {
+    const uint8_t pair = getPixel4(line, start) << 4 | getPixel4(line, start + 1);
+    for (; count > 255; count -= MAX_RLE4_RUN) {
+        *outPixelPointer++ = MAX_RLE4_RUN;
+        *outPixelPointer++ = pair;
+    }
+    *outPixelPointer++ = count;
+    *outPixelPointer++ = pair;
+    return outPixelPointer;
+}
+
+/*
+ * Encode one scan line of at least 2 pixels without end of line
+ */
+static uint8_t* bmpRle4Line(const uint8_t* line, const size_t width, uint8_t* outPixelPointer) {
+    size_t runStart = 0; // first pixel of current run
+    size_t shortRunsStart = 0; // first pixel not written yet
+
+    for (size_t base = 0; base + 2 < width + 1; base += BOUNDARY_WORD_SIZE) {
+        // the SIMD comparison reads up to pixel base + 65
+        uint64_t boundaries = base + BOUNDARY_WORD_SIZE + 2 <= width
+            ? getPairBoundaryWord(line + base / 2)
+            : getLastPairBoundaryWord(line, base, width);
+
+        while (boundaries != 0) {
+            // runs end after the first boundary behind their start
+            if (runStart > base) {
+                boundaries = runStart - base >= BOUNDARY_WORD_SIZE ? 0 : boundaries & (~(uint64_t)0 << (runStart - base));
+                if (boundaries == 0) break;
+            }
+            const size_t runEnd = base + __builtin_ctzll(boundaries) + 2;
+            boundaries &= boundaries - 1;
+
+            if (runEnd - runStart >= MIN_RLE4_RUN) {
+                outPixelPointer = writeShortRuns4(line, shortRunsStart, runStart, outPixelPointer);
+                outPixelPointer = writeRun4(line, runStart, runEnd - runStart, outPixelPointer);
+                shortRunsStart = runEnd;
+            }
+            runStart = runEnd;
+        }
+    }
+    return writeShortRuns4(line, shortRunsStart, width, outPixelPointer);
+}
+
+// Uses absolute and encoded mode of RLE_4
+size_t bmpRle4(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) {
+    uint8_t* outPixelPointer = rleData;
+
+    for (size_t i = 1; i <= height; i++) {
+        if (width == 1) {
+            *outPixelPointer++ = 1;
+            *outPixelPointer++ = *imgIn & 0xF0;
+        }
+        else {
+            outPixelPointer = bmpRle4Line(imgIn, width, outPixelPointer);
+        }
+        *outPixelPointer++ = END_OF_LINE_BYTE;
+        // end of file or end of line
+        *outPixelPointer++ = height == i ? END_OF_BITMAP_BYTE : END_OF_LINE_BYTE;
+        imgIn += stride;
+    }
+    return outPixelPointer - rleData;
+}
@@ -1,29 +1,23 @@
 #include <stdint.h>
 #include <memory.h>
 #include "bitmap.h"
-#include "util.h"
+#include "bmp_rle_scalar.h"
 
-// Uses absolute and encoded mode
-size_t bmpRleV2(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleData)
+/*
+ * Encode one scan line, 'inPixelIndex' is the index of a pixel in the scan line
+ * returns its compressed size without end of line
+ */
+static inline __attribute__((always_inline)) size_t bmpRleV2Line(const uint8_t* line, size_t width, uint8_t* rleData)
 {
-    const uint8_t bitmapPadding = getBitmapPaddingFromWidth(width);
-    const uint8_t* inPixelPointer = imgIn;
-    const uint32_t inPixelDataSize = (width + bitmapPadding) * height;
-    uint32_t inPixelIndex = 0;
-    uint32_t outPixelIndex = 0;
-    const uint32_t inPixelDataSizeNoLastPadd = inPixelDataSize - bitmapPadding;
-    const uint32_t inPixelIndexOfLastPixel = inPixelDataSizeNoLastPadd - 1;
+    const uint8_t* inPixelPointer = line;
+    size_t inPixelIndex = 0;
+    size_t outPixelIndex = 0;
     uint8_t* outPixelPointer = rleData;
     uint8_t rep = 1;
     uint8_t diff = 1;
     uint8_t isEndOfLine;
-    uint8_t isEndOfFile;
-    if (outPixelPointer == NULL)
-    {
-        throwError("some error occured");
-    }
 
-    while (inPixelIndex < inPixelDataSizeNoLastPadd)
+    while (inPixelIndex < width)
     {   //reset rep and diff
         rep = 1;
         diff = 1;
@@ -32,8 +26,7 @@ size_t bmpRleV2(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleD
         * Also never compare with padding byte to avoid comparing pixel 0 with padding 0
         * Never go over last pixel
         */
-        while (rep < 255 && diff < 255 && (inPixelIndex % (width + bitmapPadding)) < width - 1
-            && inPixelIndex < inPixelIndexOfLastPixel)
+        while (rep < 255 && diff < 255 && inPixelIndex + 1 < width)
         {
             if (inPixelPointer[inPixelIndex] == inPixelPointer[inPixelIndex + 1])
             {
@@ -53,8 +46,7 @@ size_t bmpRleV2(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleD
             }
         }
 
-        isEndOfLine = (inPixelIndex % (width + bitmapPadding)) == width - 1;
-        isEndOfFile = inPixelIndex == inPixelIndexOfLastPixel;
+        isEndOfLine = inPixelIndex + 1 == width;
 
         //here we have diff and rep pixels; write diff pixels first then rep
         if (rep >= 3)
@@ -84,17 +76,9 @@ size_t bmpRleV2(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleD
             outPixelPointer[outPixelIndex++] = rep;
             outPixelPointer[outPixelIndex++] = inPixelPointer[inPixelIndex];
             inPixelIndex += rep - 1;
-            if (isEndOfFile)
-            { // end of file
-                outPixelPointer[outPixelIndex++] = END_OF_LINE_BYTE;
-                outPixelPointer[outPixelIndex++] = END_OF_BITMAP_BYTE;
-                break;
-            }
-            else if (isEndOfLine)
-            { // end of line
-                outPixelPointer[outPixelIndex++] = END_OF_LINE_BYTE;
-                outPixelPointer[outPixelIndex++] = END_OF_LINE_BYTE;
-                inPixelIndex += (bitmapPadding + 1); // go to next scan line
+            if (isEndOfLine)
+            { // end of line or end of file, written by the scan line loop
+                return outPixelIndex;
             }
             else
             {
@@ -105,7 +89,7 @@ size_t bmpRleV2(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleD
         {
             uint8_t odd = diff % 2;
             //if end of line comes next, we write the amount of diff accordingly
-            if (isEndOfLine || isEndOfFile)
+            if (isEndOfLine)
             {
                 inPixelIndex -= diff - 1;
                 outPixelPointer[outPixelIndex++] = 00;
@@ -114,22 +98,11 @@ size_t bmpRleV2(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleD
                     outPixelPointer[outPixelIndex++] = inPixelPointer[inPixelIndex++];
                 outPixelPointer[outPixelIndex++] = inPixelPointer[inPixelIndex]; // in case inPixelIndex is last pixel we dont increment so we dont provoke seg fault
                 if (odd) outPixelPointer[outPixelIndex++] = 00;
-                if (isEndOfFile)
-                {
-                    outPixelPointer[outPixelIndex++] = END_OF_LINE_BYTE;
-                    outPixelPointer[outPixelIndex++] = END_OF_BITMAP_BYTE;
-                    break;
-                }
-                else if (isEndOfLine)
-                {
-                    outPixelPointer[outPixelIndex++] = END_OF_LINE_BYTE;
-                    outPixelPointer[outPixelIndex++] = END_OF_LINE_BYTE;
-                    inPixelIndex += (bitmapPadding + 1); // go to next scan line
-                }
+                return outPixelIndex;
             }
             // if end of line or file comes after next 2 pixels its worth to check for the upcoming pixels in case they are
             // the same as the last diff pixels we are about to write; so we can write them together in encoded mode in next loop
-            else if ((inPixelIndex % (width + bitmapPadding)) == width - 2 || inPixelIndex == inPixelIndexOfLastPixel - 1)
+            else if (inPixelIndex + 2 == width)
             {
                 if (rep == 2 && inPixelPointer[inPixelIndex] == inPixelPointer[inPixelIndex + 1])
                 {
@@ -203,19 +176,14 @@ size_t bmpRleV2(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleD
                 outPixelPointer[outPixelIndex++] = 1;
                 outPixelPointer[outPixelIndex++] = inPixelPointer[inPixelIndex];
             }
-            if (isEndOfFile)
-            { // end of file
-                outPixelPointer[outPixelIndex++] = END_OF_LINE_BYTE;
-                outPixelPointer[outPixelIndex++] = END_OF_BITMAP_BYTE;
-                break;
-            }
-            else if (isEndOfLine)
-            { // end of line
-                outPixelPointer[outPixelIndex++] = END_OF_LINE_BYTE;
-                outPixelPointer[outPixelIndex++] = END_OF_LINE_BYTE;
-                inPixelIndex += (bitmapPadding + 1); // go to next scan line
+            if (isEndOfLine)
+            { // end of line or end of file, written by the scan line loop
+                return outPixelIndex;
             }
         }
     }
     return outPixelIndex;
 }
+
+// Uses absolute and encoded mode
+DEFINE_SCALAR_KERNEL(bmpRleV2, bmpRleV2Line)
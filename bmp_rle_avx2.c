@@ -0,0 +1,22 @@
+/*
+ * AVX2 Implementation of RLE (32 pixels per comparison)
+ */
+
+#include <stdint.h> // uint
+#include <immintrin.h> // SIMD
+#include "bitmap.h"
+#include "bmp_rle_simd.h"
+
+// compare pixels [0,31] with [1,32]
+__attribute__((target("avx2")))
+static uint64_t compareBlockAvx2(const uint8_t* pixelPointer) {
+    __m256i pixels = _mm256_loadu_si256((const __m256i_u*)pixelPointer);
+    __m256i pixels2 = _mm256_loadu_si256((const __m256i_u*)(pixelPointer + 1));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(pixels, pixels2));
+}
+
+// Uses absolute and encoded mode
+__attribute__((target("avx2")))
+size_t bmpRleAvx2(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) {
+    return bmpRleSimd(imgIn, width, height, stride, rleData, 32, compareBlockAvx2);
+}
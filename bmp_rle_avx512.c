@@ -0,0 +1,22 @@
+/*
+ * AVX-512BW Implementation of RLE (64 pixels per comparison)
+ */
+
+#include <stdint.h> // uint
+#include <immintrin.h> // SIMD
+#include "bitmap.h"
+#include "bmp_rle_simd.h"
+
+// compare pixels [0,63] with [1,64]
+__attribute__((target("avx512bw")))
+static uint64_t compareBlockAvx512(const uint8_t* pixelPointer) {
+    __m512i pixels = _mm512_loadu_si512((const void*)pixelPointer);
+    __m512i pixels2 = _mm512_loadu_si512((const void*)(pixelPointer + 1));
+    return _mm512_cmpeq_epi8_mask(pixels, pixels2);
+}
+
+// Uses absolute and encoded mode
+__attribute__((target("avx512bw")))
+size_t bmpRleAvx512(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) {
+    return bmpRleSimd(imgIn, width, height, stride, rleData, 64, compareBlockAvx512);
+}
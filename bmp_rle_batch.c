@@ -0,0 +1,363 @@
+/*
+ * Batch RLE
+ * Many bitmaps are compressed into an output directory by a fixed pool of workers,
+ * every worker takes the next file from a shared counter and compresses it on its own thread
+ * Input, scan line size and output buffers of a worker are reused (and only grown) from file to file,
+ * so small bitmaps neither allocate nor fault in fresh pages
+ * A failing file is reported and skipped, the other files are still compressed
+ */
+
+#define _GNU_SOURCE // strerror_r
+#include <stdio.h> // fprintf
+#include <stdlib.h> // malloc
+#include <string.h> // strrchr, strerror_r
+#include <errno.h>
+#include <fcntl.h> // open
+#include <unistd.h> // read, write
+#include <limits.h> // PATH_MAX
+#include <sys/stat.h> // fstat, stat
+#include <pthread.h>
+#include <stdatomic.h>
+#include "bitmap.h"
+#include "util.h"
+
+#define ERROR_MESSAGE_SIZE 256
+
+struct batchJob {
+    char** inputFiles;
+    size_t fileCount;
+    const char* outputDirectory;
+    long versionNumber;
+    const struct tuningProfile* profile; // selects the version of every bitmap if not NULL
+    char isDelta;
+    const char** skipReasons; // why an input file is reported instead of compressed, NULL if it is compressed
+    atomic_size_t nextFile;
+    atomic_size_t failures;
+};
+
+// input file by the name of its output file
+struct outputName {
+    const char* fileName;
+    size_t file;
+};
+
+// buffers of a worker, reused for every file
+struct batchWorker {
+    struct batchJob* job;
+    uint8_t* inputBuffer;
+    size_t inputCapacity;
+    size_t* lineSizes;
+    size_t lineSizesCapacity;
+    uint8_t* outputBuffer;
+    size_t outputCapacity;
+    char message[ERROR_MESSAGE_SIZE];
+};
+
+/*
+ * Grow 'buffer' to at least 'size' bytes, the content is not kept
+ * returns 0 if there is not enough memory
+ */
+static uint8_t reserve(void** buffer, size_t* capacity, const size_t size) {
+    if (size <= *capacity) return 1;
+    free(*buffer);
+    *buffer = malloc(size);
+    *capacity = *buffer == NULL ? 0 : size;
+    return *buffer != NULL;
+}
+
+/*
+ * Store the description of 'errno' prefixed by 'action' as message of 'worker'
+ */
+static char* systemError(struct batchWorker* worker, const char* action) {
+    char description[ERROR_MESSAGE_SIZE];
+    snprintf(worker->message, ERROR_MESSAGE_SIZE, "%s: %s", action, strerror_r(errno, description, ERROR_MESSAGE_SIZE));
+    return worker->message;
+}
+
+static uint8_t readAll(const int fd, uint8_t* buffer, size_t size) {
+    while (size > 0) {
+        const ssize_t count = read(fd, buffer, size);
+        if (count <= 0) {
+            if (count == -1 && errno == EINTR) continue;
+            return 0;
+        }
+        buffer += count;
+        size -= count;
+    }
+    return 1;
+}
+
+static uint8_t writeAll(const int fd, const uint8_t* buffer, size_t size) {
+    while (size > 0) {
+        const ssize_t count = write(fd, buffer, size);
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        buffer += count;
+        size -= count;
+    }
+    return 1;
+}
+
+/*
+ * Read 'inputFile' into the input buffer of 'worker', returns its size or -1
+ */
+static long readInputFile(struct batchWorker* worker, const char* inputFile) {
+    const int fd = open(inputFile, O_RDONLY);
+    if (fd == -1) return -1;
+    struct stat inputStat;
+    long inputSize = -1;
+    if (fstat(fd, &inputStat) == 0
+        && reserve((void**)&worker->inputBuffer, &worker->inputCapacity, inputStat.st_size)
+        && readAll(fd, worker->inputBuffer, inputStat.st_size)) {
+        inputSize = inputStat.st_size;
+    }
+    const int readErrno = errno;
+    close(fd);
+    errno = readErrno;
+    return inputSize;
+}
+
+static const char* getFileName(const char* inputFile) {
+    const char* fileName = strrchr(inputFile, '/');
+    return fileName == NULL ? inputFile : fileName + 1;
+}
+
+/*
+ * Write the path of the output file of 'inputFile' (in the output directory, named like 'inputFile') into 'outputFile'
+ * returns 0 if it is longer than PATH_MAX
+ */
+static uint8_t getOutputFile(const struct batchJob* job, const char* inputFile, char* outputFile) {
+    if (snprintf(outputFile, PATH_MAX, "%s/%s", job->outputDirectory, getFileName(inputFile)) >= PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Write 'size' bytes of the output buffer of 'worker' into the output file of 'inputFile'
+ */
+static uint8_t writeOutputFile(struct batchWorker* worker, const char* inputFile, const size_t size) {
+    char outputFile[PATH_MAX];
+    if (!getOutputFile(worker->job, inputFile, outputFile)) return 0;
+
+    const int fd = open(outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return 0;
+    const uint8_t isWritten = writeAll(fd, worker->outputBuffer, size);
+    const int writeErrno = errno;
+    if (close(fd) == -1 && isWritten) return 0;
+    errno = writeErrno;
+    return isWritten;
+}
+
+/*
+ * Compress 'inputFile' into the output directory
+ * returns NULL on success or the reason of the failure
+ */
+static char* compressFile(struct batchWorker* worker, const char* inputFile) {
+    const long inputSize = readInputFile(worker, inputFile);
+    if (inputSize == -1) return systemError(worker, "Error while reading input file");
+
+    const uint8_t* inputBuffer = worker->inputBuffer;
+    struct bitmapHeader header;
+    uint8_t code = parseBitmap(inputBuffer, inputSize, &header);
+    if (code == ERROR_BITS_PER_PIXEL) code = parseTrueColorBitmap(inputBuffer, inputSize, &header);
+    if (code != SUCCESS_BITMAP_VALIDATION) return getValidationErrorMessage(code);
+
+    const size_t width = header.width;
+    const size_t height = header.height;
+    // top-down bitmaps are compressed from their last scan line upwards
+    const uint8_t* inPixelPointer = getBottomLine(inputBuffer, &header);
+    const ptrdiff_t stride = getBitmapStride(&header);
+    const uint8_t isRle4 = header.bitCount == BITS_PER_PIXEL_RLE4;
+    const uint8_t isQuantised = header.bitCount == BITS_PER_PIXEL_24 || header.bitCount == BITS_PER_PIXEL_32;
+    if ((isRle4 || isQuantised) && worker->job->isDelta) return "Delta(-D) is only supported for 8bpp bitmaps";
+    long versionNumber = worker->job->versionNumber;
+    if (worker->job->profile != NULL && !isRle4 && !isQuantised) versionNumber = selectTunedVersion(worker->job->profile, inPixelPointer, width, height, stride);
+    bmpRleFunction bmpRle = isRle4 ? bmpRle4 : getCompressionFunction(versionNumber);
+    if (isQuantised) bmpRle = header.bitCount == BITS_PER_PIXEL_24 ? bmpRleQuantise24 : bmpRleQuantise32;
+    bmpRleMeasureFunction bmpRleMeasure = isRle4 || worker->job->isDelta || isQuantised ? NULL : getMeasureFunction(versionNumber);
+
+    // the output buffer is exact if the version can measure its output
+    size_t pixelDataSize = getMaxPixelDataSize(width, height);
+    if (bmpRleMeasure != NULL) {
+        if (!reserve((void**)&worker->lineSizes, &worker->lineSizesCapacity, sizeof(size_t) * height)) {
+            return systemError(worker, "Error while allocating memory");
+        }
+        pixelDataSize = bmpRleMeasure(inPixelPointer, width, height, stride, worker->lineSizes);
+    }
+    // -D writes the background as index 0, the palette is reordered to match
+    const uint8_t isDelta = worker->job->isDelta;
+    const uint8_t background = isDelta ? getDominantPixel(inPixelPointer, width, height, stride) : 0;
+    const uint32_t offBits = isQuantised ? QUANTISED_OFF_BITS : isDelta ? calcOffBitsForDeltaRle(inputBuffer, background) : calcOffBitsForRle(inputBuffer);
+    if (!reserve((void**)&worker->outputBuffer, &worker->outputCapacity, offBits + pixelDataSize)) {
+        return systemError(worker, "Error while allocating memory");
+    }
+
+    if (isQuantised) writeBitmapMetadataForQuantisedRle(inputBuffer, worker->outputBuffer);
+    else if (isDelta) writeBitmapMetadataForDeltaRle(inputBuffer, worker->outputBuffer, background);
+    else writeBitmapMetadataForRle(inputBuffer, worker->outputBuffer);
+    uint8_t* rleData = worker->outputBuffer + offBits;
+    const size_t rleSize = isDelta ? bmpRleDeltaBackground(inPixelPointer, width, height, stride, background, rleData)
+        : bmpRle(inPixelPointer, width, height, stride, rleData);
+    // the quantising and delta versions return 0 if their line buffer can't be allocated
+    if (rleSize == 0) return systemError(worker, "Error while allocating memory");
+    if (!isRleSizeValid(offBits, rleSize)) return getValidationErrorMessage(ERROR_TOO_LARGE);
+    const uint32_t size = writeBitmapSizesForRle(worker->outputBuffer, offBits, rleSize);
+
+    if (!writeOutputFile(worker, inputFile, size)) return systemError(worker, "Error while writing output file");
+    return NULL;
+}
+
+static int compareOutputNames(const void* a, const void* b) {
+    const struct outputName* nameA = a;
+    const struct outputName* nameB = b;
+    const int order = strcmp(nameA->fileName, nameB->fileName);
+    if (order != 0) return order;
+    return (nameA->file > nameB->file) - (nameA->file < nameB->file);
+}
+
+/*
+ * Mark every input file of 'job' whose output file name is taken by an earlier input file (e.g. a/x.bmp and b/x.bmp),
+ * it would overwrite the earlier output
+ */
+static void markDuplicateOutputs(struct batchJob* job) {
+    struct outputName* names = malloc(sizeof(struct outputName) * job->fileCount);
+    if (names == NULL) throwSystemError("Error while allocating memory");
+    for (size_t i = 0; i < job->fileCount; i++) {
+        names[i].fileName = getFileName(job->inputFiles[i]);
+        names[i].file = i;
+    }
+    // equal names are sorted by their position, the first one keeps its output
+    qsort(names, job->fileCount, sizeof(struct outputName), compareOutputNames);
+
+    for (size_t i = 1; i < job->fileCount; i++) {
+        if (strcmp(names[i].fileName, names[i - 1].fileName) == 0) {
+            job->skipReasons[names[i].file] = "Output file name is already used by another input file";
+        }
+    }
+    free(names);
+}
+
+/*
+ * Mark every input file of 'job' that is its own output file (e.g. -O d d/x.bmp or a hard link),
+ * truncating the output would destroy the input
+ */
+static void markInputOutputs(struct batchJob* job) {
+    for (size_t i = 0; i < job->fileCount; i++) {
+        char outputFile[PATH_MAX];
+        struct stat inputStat;
+        struct stat outputStat;
+        if (job->skipReasons[i] != NULL || !getOutputFile(job, job->inputFiles[i], outputFile)) continue;
+        // a missing input or output is not the same file, a missing input is reported by its worker
+        if (stat(job->inputFiles[i], &inputStat) == 0 && stat(outputFile, &outputStat) == 0
+            && inputStat.st_dev == outputStat.st_dev && inputStat.st_ino == outputStat.st_ino) {
+            job->skipReasons[i] = "Output file is the input file";
+        }
+    }
+}
+
+static void* runBatchWorker(void* arg) {
+    struct batchWorker* worker = arg;
+    struct batchJob* job = worker->job;
+    size_t file;
+
+    while ((file = atomic_fetch_add(&job->nextFile, 1)) < job->fileCount) {
+        if (job->skipReasons[file] != NULL) continue;
+        const char* message = compressFile(worker, job->inputFiles[file]);
+        if (message != NULL) {
+            fprintf(stderr, "%s: %s\n", job->inputFiles[file], message);
+            atomic_fetch_add(&job->failures, 1);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Compress 'fileCount' bitmaps into 'outputDirectory' on 'threadCount' workers
+ * with 'versionNumber' or, if 'profile' is not NULL, with the tuned version of every bitmap
+ * every bitmap keeps its file name, failures, file names taken by an earlier input file and input files
+ * that are their own output file are reported on stderr
+ * returns the number of bitmaps that could not be compressed
+ */
+size_t bmpRleBatch(char** inputFiles, size_t fileCount, const char* outputDirectory, long versionNumber, const struct tuningProfile* profile,
+    char isDelta, size_t threadCount) {
+    if (threadCount > fileCount) threadCount = fileCount;
+    if (threadCount == 0) return 0;
+
+    struct batchJob job;
+    job.inputFiles = inputFiles;
+    job.fileCount = fileCount;
+    job.outputDirectory = outputDirectory;
+    job.versionNumber = versionNumber;
+    job.profile = profile;
+    job.isDelta = isDelta;
+    atomic_init(&job.nextFile, 0);
+    atomic_init(&job.failures, 0);
+
+    job.skipReasons = calloc(fileCount, sizeof(const char*));
+    if (job.skipReasons == NULL) throwSystemError("Error while allocating memory");
+    markDuplicateOutputs(&job);
+    markInputOutputs(&job);
+    for (size_t i = 0; i < fileCount; i++) {
+        if (job.skipReasons[i] == NULL) continue;
+        fprintf(stderr, "%s: %s\n", inputFiles[i], job.skipReasons[i]);
+        atomic_fetch_add(&job.failures, 1);
+    }
+
+    pthread_t* threads = malloc(sizeof(pthread_t) * threadCount);
+    struct batchWorker* workers = calloc(threadCount, sizeof(struct batchWorker));
+    uint8_t* isStarted = calloc(threadCount, 1);
+    if (threads == NULL || workers == NULL || isStarted == NULL) throwSystemError("Error while allocating memory");
+
+    // the calling thread is worker 0, files of workers that can't be started are taken by the others
+    for (size_t i = 0; i < threadCount; i++) {
+        workers[i].job = &job;
+    }
+    for (size_t i = 1; i < threadCount; i++) {
+        isStarted[i] = pthread_create(&threads[i], NULL, runBatchWorker, &workers[i]) == 0;
+    }
+    runBatchWorker(&workers[0]);
+    for (size_t i = 1; i < threadCount; i++) {
+        if (isStarted[i]) pthread_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        free(workers[i].inputBuffer);
+        free(workers[i].lineSizes);
+        free(workers[i].outputBuffer);
+    }
+    free(isStarted);
+    free(workers);
+    free(threads);
+    free(job.skipReasons);
+    return atomic_load(&job.failures);
+}
+
+/*
+ * Read the paths of a manifest file, one path per line, empty lines are skipped
+ * the paths are appended to 'inputFiles' holding 'fileCount' paths, returns the new array
+ */
+char** readManifest(const char* manifestFile, char** inputFiles, size_t* fileCount) {
+    FILE* manifest = fopen(manifestFile, "r");
+    if (manifest == NULL) throwSystemError("Error while opening manifest file");
+
+    char* line = NULL;
+    size_t lineCapacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &lineCapacity, manifest)) != -1) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+        if (length == 0) continue;
+
+        inputFiles = realloc(inputFiles, sizeof(char*) * (*fileCount + 1));
+        if (inputFiles == NULL) throwSystemError("Error while allocating memory");
+        inputFiles[*fileCount] = strdup(line);
+        if (inputFiles[*fileCount] == NULL) throwSystemError("Error while allocating memory");
+        (*fileCount)++;
+    }
+    free(line);
+    fclose(manifest);
+    return inputFiles;
+}
@@ -0,0 +1,271 @@
+/*
+ * Benchmark of a compression function
+ * Warmup runs are discarded, the measured runs are reported as min, median, p95, p99 and mean
+ * together with the throughput (MB of uncompressed pixels per second) and TSC cycles per pixel of the median run
+ * Cold runs flush input and output from all caches before every run, hot runs measure the encoding loop
+ * With --counters hardware performance counters (perf_event_open) are enabled around every measured run,
+ * counters the kernel or the CPU doesn't provide are left out, without any the report only contains timings
+ */
+
+#define _GNU_SOURCE // sched_setaffinity
+#include <stdio.h> // fprintf
+#include <stdlib.h> // malloc, qsort
+#include <sched.h> // sched_setaffinity
+#include <time.h> // clock_gettime
+#include <string.h> // memset, strerror
+#include <errno.h>
+#include <unistd.h> // syscall, read, close
+#include <sys/ioctl.h> // ioctl
+#include <sys/syscall.h> // SYS_perf_event_open
+#include <linux/perf_event.h>
+#include <x86intrin.h> // __rdtsc, _mm_clflush
+#include "bitmap.h"
+#include "util.h"
+
+#define CACHE_LINE_SIZE 64
+
+#define COUNTER_CYCLES 0
+#define COUNTER_INSTRUCTIONS 1
+#define COUNTER_BRANCH_MISSES 2
+#define COUNTER_L1D_MISSES 3
+#define COUNTER_LLC_MISSES 4
+#define COUNTER_COUNT 5
+
+static const char* counterNames[COUNTER_COUNT] = { "cycles", "instructions", "branchMisses", "l1dMisses", "llcMisses" };
+
+// file descriptors (-1 if not available) and sums over all measured runs of the hardware counters
+struct counters {
+    int fds[COUNTER_COUNT];
+    double sums[COUNTER_COUNT];
+};
+
+static int openCounter(const uint32_t type, const uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // threads started by 'bmpRleParallel' are counted as well
+    attr.inherit = 1;
+    // the counters may be multiplexed, the counts are scaled by enabled / running time
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * Open all counters of the calling process, returns 0 if none is available
+ */
+static uint8_t openCounters(struct counters* counters) {
+    const uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    counters->fds[COUNTER_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counters->fds[COUNTER_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counters->fds[COUNTER_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    counters->fds[COUNTER_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE, l1dReadMiss);
+    counters->fds[COUNTER_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+    uint8_t isAvailable = 0;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        counters->sums[i] = 0.0;
+        isAvailable |= counters->fds[i] != -1;
+    }
+    return isAvailable;
+}
+
+static void startCounters(const struct counters* counters) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (counters->fds[i] == -1) continue;
+        ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/*
+ * Stop the counters and add the counts of this run to their sums
+ */
+static void stopCounters(struct counters* counters, const uint8_t isMeasured) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (counters->fds[i] != -1) ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        // value, time enabled, time running
+        uint64_t values[3];
+        if (counters->fds[i] == -1 || read(counters->fds[i], values, sizeof(values)) != sizeof(values)) continue;
+        if (isMeasured && values[2] > 0) counters->sums[i] += (double)values[0] * values[1] / values[2];
+    }
+}
+
+static void closeCounters(const struct counters* counters) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (counters->fds[i] != -1) close(counters->fds[i]);
+    }
+}
+
+/*
+ * Number of tokens (encoded mode, absolute mode and escapes) of the RLE_8 pixel data 'rleData'
+ */
+static size_t countTokens(const uint8_t* rleData, const size_t rleSize) {
+    size_t tokens = 0;
+    for (size_t i = 0; i + 1 < rleSize; tokens++) {
+        if (rleData[i] != 0) i += 2;
+        else if (rleData[i + 1] == DELTA_BYTE) i += 4;
+        else if (rleData[i + 1] <= END_OF_BITMAP_BYTE) i += 2;
+        // absolute mode padded to 2 bytes
+        else i += 2 + rleData[i + 1] + rleData[i + 1] % 2;
+    }
+    return tokens;
+}
+
+/*
+ * Print the mean counts of a run per megapixel and per output token
+ */
+static void printCounters(const struct counters* counters, const size_t runs, const double megapixels, const size_t tokens,
+    const uint8_t isJson, FILE* report) {
+    double means[COUNTER_COUNT];
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        means[i] = counters->sums[i] / runs;
+    }
+    const uint8_t hasIpc = counters->fds[COUNTER_CYCLES] != -1 && counters->fds[COUNTER_INSTRUCTIONS] != -1 && means[COUNTER_CYCLES] > 0.0;
+    const double ipc = hasIpc ? means[COUNTER_INSTRUCTIONS] / means[COUNTER_CYCLES] : 0.0;
+
+    if (isJson) {
+        fprintf(report, ", \"tokens\": %zu, \"counters\": {", tokens);
+        const char* separator = "";
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (counters->fds[i] == -1) continue;
+            fprintf(report, "%s\"%s\": {\"perRun\": %.0f, \"perMegapixel\": %.1f, \"perToken\": %.4f}",
+                separator, counterNames[i], means[i], means[i] / megapixels, tokens > 0 ? means[i] / tokens : 0.0);
+            separator = ", ";
+        }
+        if (hasIpc) fprintf(report, "%s\"ipc\": %.3f", separator, ipc);
+        fprintf(report, "}");
+        return;
+    }
+    fprintf(report, "Counters (mean of a run, per megapixel, per token of %zu tokens):\n", tokens);
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (counters->fds[i] == -1) {
+            fprintf(report, "%s: not available\n", counterNames[i]);
+            continue;
+        }
+        fprintf(report, "%s: %.0f, %.1f, %.4f\n", counterNames[i], means[i], means[i] / megapixels, tokens > 0 ? means[i] / tokens : 0.0);
+    }
+    if (hasIpc) fprintf(report, "IPC: %.3f\n", ipc);
+}
+
+/*
+ * Evict 'size' bytes of 'buffer' from every cache level
+ */
+static void flushCaches(const uint8_t* buffer, const size_t size) {
+    for (size_t i = 0; i < size; i += CACHE_LINE_SIZE) {
+        _mm_clflush(buffer + i);
+    }
+    if (size > 0) _mm_clflush(buffer + size - 1);
+    _mm_mfence();
+}
+
+static int compareDouble(const void* a, const void* b) {
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Nearest-rank 'percentile' of the sorted 'values'
+ */
+static double getPercentile(const double* values, const size_t count, const double percentile) {
+    size_t rank = (size_t)(percentile / 100.0 * count + 0.999999);
+    if (rank < 1) rank = 1;
+    return values[(rank > count ? count : rank) - 1];
+}
+
+/*
+ * Pin the calling thread to 'cpu', threads started afterwards inherit the affinity
+ */
+static void pinToCpu(const long cpu) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    if (cpu >= CPU_SETSIZE || sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) throwSystemError("Could not pin to CPU(--cpu)");
+}
+
+/*
+ * Run 'bmpRle' ('warmupRuns' + 'runs' times) on 'threadCount' threads and print its statistics to 'report'
+ * 'rleDataSize' is the size of 'rleData', flushed before every cold run
+ * returns the size of the pixel data in 'rleData'
+ */
+size_t bmpRleBenchmark(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData, size_t rleDataSize,
+    bmpRleFunction bmpRle, size_t threadCount, const size_t* lineSizes, const struct benchmarkOptions* options, const char* label, FILE* report) {
+    // the input starts at the top scan line if the stride is negative
+    const uint8_t* inputStart = stride < 0 ? imgIn + (ptrdiff_t)(height - 1) * stride : imgIn;
+    const size_t inputSize = (size_t)(stride < 0 ? -stride : stride) * height;
+    const size_t runs = options->runs;
+    double* times = malloc(sizeof(double) * runs);
+    double* cycles = malloc(sizeof(double) * runs);
+    if (times == NULL || cycles == NULL) throwSystemError("Error while allocating memory");
+    if (options->cpu >= 0) pinToCpu(options->cpu);
+
+    struct counters counters;
+    uint8_t isCounting = options->isCounting && openCounters(&counters);
+    if (options->isCounting && !isCounting) {
+        fprintf(stderr, "Hardware counters are not available (%s), reporting timings only\n", strerror(errno));
+    }
+
+    size_t rleSize = 0;
+    for (long i = 0; i < options->warmupRuns + (long)runs; i++) {
+        if (options->isCold) {
+            flushCaches(inputStart, inputSize);
+            flushCaches(rleData, rleDataSize);
+        }
+        struct timespec start;
+        struct timespec end;
+        if (isCounting) startCounters(&counters);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const uint64_t startCycles = __rdtsc();
+        rleSize = bmpRleParallel(imgIn, width, height, stride, rleData, bmpRle, threadCount, lineSizes);
+        const uint64_t endCycles = __rdtsc();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (isCounting) stopCounters(&counters, i >= options->warmupRuns);
+
+        if (i < options->warmupRuns) continue;
+        times[i - options->warmupRuns] = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+        cycles[i - options->warmupRuns] = endCycles - startCycles;
+    }
+
+    qsort(times, runs, sizeof(double), compareDouble);
+    qsort(cycles, runs, sizeof(double), compareDouble);
+    double mean = 0.0;
+    for (size_t i = 0; i < runs; i++) {
+        mean += times[i] / runs;
+    }
+    const double median = getPercentile(times, runs, 50);
+    const double megabytesPerSecond = median > 0.0 ? width * height / median / 1e6 : 0.0;
+    const double cyclesPerPixel = getPercentile(cycles, runs, 50) / (width * height);
+
+    if (options->isJson) {
+        fprintf(report, "{\"version\": \"%s\", \"width\": %zu, \"height\": %zu, \"threads\": %zu, \"cpu\": %ld, \"cold\": %s, "
+            "\"warmupRuns\": %ld, \"runs\": %zu, \"rleSize\": %zu, "
+            "\"seconds\": {\"min\": %.9f, \"median\": %.9f, \"p95\": %.9f, \"p99\": %.9f, \"mean\": %.9f}, "
+            "\"megabytesPerSecond\": %.3f, \"cyclesPerPixel\": %.4f",
+            label, width, height, threadCount, options->cpu, options->isCold ? "true" : "false",
+            options->warmupRuns, runs, rleSize,
+            times[0], median, getPercentile(times, runs, 95), getPercentile(times, runs, 99), mean,
+            megabytesPerSecond, cyclesPerPixel);
+        if (isCounting) printCounters(&counters, runs, width * height / 1e6, countTokens(rleData, rleSize), 1, report);
+        fprintf(report, "}\n");
+    }
+    else {
+        fprintf(report, "%s, %zux%zu pixels, %zu threads, %s cache, %ld warmup runs, %zu runs\n",
+            label, width, height, threadCount, options->isCold ? "cold" : "hot", options->warmupRuns, runs);
+        fprintf(report, "Min: %f\nMedian: %f\nP95: %f\nP99: %f\nMean: %f\n",
+            times[0], median, getPercentile(times, runs, 95), getPercentile(times, runs, 99), mean);
+        fprintf(report, "Throughput (median): %.1f MB/s\nCycles per pixel (median): %.3f\n", megabytesPerSecond, cyclesPerPixel);
+        if (isCounting) printCounters(&counters, runs, width * height / 1e6, countTokens(rleData, rleSize), 0, report);
+    }
+
+    if (isCounting) closeCounters(&counters);
+    free(times);
+    free(cycles);
+    return rleSize;
+}
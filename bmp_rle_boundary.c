@@ -0,0 +1,195 @@
+/*
+ * Run-boundary Implementation of RLE
+ * Every scan line is turned into a bitmask of run boundaries (bit k set if pixel k differs from pixel k + 1),
+ * the kernel jumps from boundary to boundary with count-trailing-zeros,
+ * so its cost depends on the number of runs instead of the number of pixels
+ * The same walk without writing returns the exact compressed size of every scan line
+ */
+
+#include <stdint.h> // uint
+#include <memory.h> // memcpy
+#include <emmintrin.h> // SIMD
+#include "bitmap.h"
+
+// pixels compared per boundary word
+#define BOUNDARY_WORD_SIZE 64
+// longer absolute mode sequences are split into even chunks, so no padding byte is needed
+#define MAX_ABSOLUTE_CHUNK 254
+#define MAX_ENCODED_RUN 255
+
+/*
+ * Returns the run boundaries of pixels [0,63] compared with [1,64]
+ */
+static inline uint64_t getBoundaryWord(const uint8_t* pixelPointer) {
+    uint64_t equalMask = 0;
+    for (int i = 0; i < BOUNDARY_WORD_SIZE; i += 16) {
+        __m128i pixels = _mm_loadu_si128((const __m128i_u*)(pixelPointer + i));
+        __m128i pixels2 = _mm_loadu_si128((const __m128i_u*)(pixelPointer + i + 1));
+        equalMask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(pixels, pixels2)) << i;
+    }
+    return ~equalMask;
+}
+
+/*
+ * Returns the run boundaries of the last (at most 64) pixels of a scan line,
+ * the last pixel is always a boundary
+ */
+static inline uint64_t getLastBoundaryWord(const uint8_t* pixelPointer, const size_t count) {
+    uint64_t boundaries = (uint64_t)1 << (count - 1);
+    for (size_t k = 0; k + 1 < count; k++) {
+        boundaries |= (uint64_t)(pixelPointer[k] != pixelPointer[k + 1]) << k;
+    }
+    return boundaries;
+}
+
+/*
+ * Write 'count' pixels of runs shorter than 3 pixels
+ */
+static inline uint8_t* writeShortRuns(const uint8_t* inPixelPointer, size_t count, uint8_t* outPixelPointer) {
+    while (count > 2) {
+        // absolute mode [00 count pixel1 pixel2 ...]
+        const uint8_t chunk = count > MAX_ENCODED_RUN ? MAX_ABSOLUTE_CHUNK : count;
+        *outPixelPointer++ = 0;
+        *outPixelPointer++ = chunk;
+        memcpy(outPixelPointer, inPixelPointer, chunk);
+        outPixelPointer += chunk;
+        if (chunk % 2 == 1) {
+            // 2-byte alignment
+            *outPixelPointer++ = 0;
+        }
+        inPixelPointer += chunk;
+        count -= chunk;
+    }
+    if (count == 2 && inPixelPointer[0] == inPixelPointer[1]) {
+        *outPixelPointer++ = 2;
+        *outPixelPointer++ = inPixelPointer[0];
+    }
+    else {
+        // encoded mode [01 pixel]
+        for (size_t i = 0; i < count; i++) {
+            *outPixelPointer++ = 1;
+            *outPixelPointer++ = inPixelPointer[i];
+        }
+    }
+    return outPixelPointer;
+}
+
+/*
+ * Size of 'count' pixels of runs shorter than 3 pixels written by 'writeShortRuns'
+ */
+static inline size_t measureShortRuns(const uint8_t* inPixelPointer, size_t count) {
+    size_t size = 0;
+    while (count > 2) {
+        const uint8_t chunk = count > MAX_ENCODED_RUN ? MAX_ABSOLUTE_CHUNK : count;
+        size += 2 + chunk + chunk % 2;
+        inPixelPointer += chunk;
+        count -= chunk;
+    }
+    if (count == 2 && inPixelPointer[0] == inPixelPointer[1]) {
+        return size + 2;
+    }
+    return size + 2 * count;
+}
+
+/*
+ * Write a run of 'count' equal pixels in encoded mode
+ */
+static inline uint8_t* writeRun(const uint8_t pixel, size_t count, uint8_t* outPixelPointer) {
+    for (; count > MAX_ENCODED_RUN; count -= MAX_ENCODED_RUN) {
+        *outPixelPointer++ = MAX_ENCODED_RUN;
+        *outPixelPointer++ = pixel;
+    }
+    *outPixelPointer++ = count;
+    *outPixelPointer++ = pixel;
+    return outPixelPointer;
+}
+
+/*
+ * Size of a run of 'count' equal pixels written by 'writeRun'
+ */
+static inline size_t measureRun(const size_t count) {
+    return 2 * ((count + MAX_ENCODED_RUN - 1) / MAX_ENCODED_RUN);
+}
+
+/*
+ * Encode one scan line without end of line, returns its compressed size
+ * if 'isMeasuring' nothing is written and 'outPixelPointer' may be NULL
+ * always inlined, so the writing and the measuring walk are specialised
+ */
+static inline __attribute__((always_inline)) size_t bmpRleBoundaryLine(const uint8_t* line, const size_t width, uint8_t* outPixelPointer, const int isMeasuring) {
+    size_t outPixelIndex = 0;
+    size_t runStart = 0; // first pixel of current run
+    size_t shortRunsStart = 0; // first pixel not written yet
+
+    for (size_t base = 0; base < width; base += BOUNDARY_WORD_SIZE) {
+        uint64_t boundaries = base + BOUNDARY_WORD_SIZE < width
+            ? getBoundaryWord(line + base)
+            : getLastBoundaryWord(line + base, width - base);
+
+        // jump to the end of every run
+        while (boundaries != 0) {
+            const size_t runEnd = base + __builtin_ctzll(boundaries) + 1;
+            boundaries &= boundaries - 1;
+
+            if (runEnd - runStart >= 3) {
+                if (isMeasuring) {
+                    outPixelIndex += measureShortRuns(line + shortRunsStart, runStart - shortRunsStart) + measureRun(runEnd - runStart);
+                }
+                else {
+                    uint8_t* end = writeShortRuns(line + shortRunsStart, runStart - shortRunsStart, outPixelPointer + outPixelIndex);
+                    outPixelIndex = writeRun(line[runStart], runEnd - runStart, end) - outPixelPointer;
+                }
+                shortRunsStart = runEnd;
+            }
+            runStart = runEnd;
+        }
+    }
+    if (isMeasuring) {
+        return outPixelIndex + measureShortRuns(line + shortRunsStart, width - shortRunsStart);
+    }
+    return writeShortRuns(line + shortRunsStart, width - shortRunsStart, outPixelPointer + outPixelIndex) - outPixelPointer;
+}
+
+// Uses absolute and encoded mode
+size_t bmpRleBoundary(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) {
+    uint8_t* outPixelPointer = rleData;
+
+    for (size_t i = 1; i <= height; i++) {
+        outPixelPointer += bmpRleBoundaryLine(imgIn, width, outPixelPointer, 0);
+        *outPixelPointer++ = END_OF_LINE_BYTE;
+        // end of file or end of line
+        *outPixelPointer++ = height == i ? END_OF_BITMAP_BYTE : END_OF_LINE_BYTE;
+        imgIn += stride;
+    }
+    return outPixelPointer - rleData;
+}
+
+/*
+ * Encode the 'width' pixels of 'line' without end of line, returns the size written to 'rleData'
+ */
+size_t bmpRleBoundaryWriteLine(const uint8_t* line, size_t width, uint8_t* rleData) {
+    return bmpRleBoundaryLine(line, width, rleData, 0);
+}
+
+/*
+ * Exact size of the 'width' pixels of 'line' written by 'bmpRleBoundaryWriteLine'
+ */
+size_t bmpRleBoundaryMeasureLine(const uint8_t* line, size_t width) {
+    return bmpRleBoundaryLine(line, width, NULL, 1);
+}
+
+/*
+ * Exact size of the pixel data written by 'bmpRleBoundary' without writing anything
+ * if 'lineSizes' is not NULL the size of every scan line (inclusive end of line) is stored in it
+ */
+size_t bmpRleBoundaryMeasure(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, size_t* lineSizes) {
+    size_t pixelDataSize = 0;
+
+    for (size_t i = 0; i < height; i++) {
+        const size_t size = bmpRleBoundaryLine(imgIn, width, NULL, 1) + 2;
+        if (lineSizes != NULL) lineSizes[i] = size;
+        pixelDataSize += size;
+        imgIn += stride;
+    }
+    return pixelDataSize;
+}
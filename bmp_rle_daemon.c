@@ -0,0 +1,283 @@
+/*
+ * Encode daemon
+ * The daemon listens on a Unix domain socket (SOCK_SEQPACKET, one message per request and reply), a client hands over
+ * every bitmap as a sealed memfd and gets the compressed bitmap back as a sealed memfd, the pixels never pass the socket
+ * A fixed pool of workers accepts the connections, every worker serves one connection at a time with its own
+ * libbmprle context, whose buffers are reserved and faulted in at startup, so small bitmaps neither allocate
+ * nor fault in fresh pages and a request never waits for a hand-over between threads
+ * Requests fail with an 'ERROR_*' code of bitmap.h in the reply, the daemon keeps running
+ */
+
+#define _GNU_SOURCE // memfd_create, accept4, MSG_CMSG_CLOEXEC
+#include <stdio.h> // fprintf
+#include <stdlib.h> // malloc
+#include <string.h> // strlen, memcpy
+#include <errno.h>
+#include <signal.h> // sigwait
+#include <time.h> // clock_gettime
+#include <fcntl.h> // F_ADD_SEALS
+#include <unistd.h> // close, unlink
+#include <sys/mman.h> // mmap, memfd_create
+#include <sys/socket.h>
+#include <sys/stat.h> // fstat
+#include <sys/un.h> // sockaddr_un
+#include <pthread.h>
+#include "bitmap.h"
+#include "bmprle.h"
+#include "util.h"
+
+// pending connections before the workers accept them
+#define DAEMON_BACKLOG 64
+// buffers of every worker are faulted in for bitmaps up to this size
+#define DAEMON_RESERVED_WIDTH 1024
+#define DAEMON_RESERVED_HEIGHT 1024
+// a bitmap handed to the daemon can't shrink or change while it is read, the compressed bitmap is handed back read-only
+#define REQUIRED_SEALS (F_SEAL_SHRINK | F_SEAL_WRITE)
+#define OUTPUT_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)
+
+struct daemonWorker {
+    int listenSocket;
+    bmpRleContext* context;
+};
+
+/*
+ * Send 'message' of 'size' bytes and the descriptor 'fd' (if not -1) as one message
+ * returns 0 if the message can't be sent
+ */
+static uint8_t sendMessage(const int connection, const void* message, const size_t size, const int fd) {
+    struct iovec part = { (void*)message, size };
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr header = { 0 };
+    header.msg_iov = &part;
+    header.msg_iovlen = 1;
+    if (fd != -1) {
+        header.msg_control = control.buffer;
+        header.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr* descriptor = CMSG_FIRSTHDR(&header);
+        descriptor->cmsg_level = SOL_SOCKET;
+        descriptor->cmsg_type = SCM_RIGHTS;
+        descriptor->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(descriptor), &fd, sizeof(int));
+    }
+    // a client that went away must not stop the daemon with SIGPIPE
+    return sendmsg(connection, &header, MSG_NOSIGNAL) == (ssize_t)size;
+}
+
+/*
+ * Receive a message of exactly 'size' bytes into 'message' and its descriptor into 'fd' (-1 if none was sent)
+ * returns 1 on success, 0 if the connection was closed and -1 for a malformed message or an error
+ */
+static int receiveMessage(const int connection, void* message, const size_t size, int* fd) {
+    struct iovec part = { message, size };
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr header = { 0 };
+    header.msg_iov = &part;
+    header.msg_iovlen = 1;
+    header.msg_control = control.buffer;
+    header.msg_controllen = sizeof(control.buffer);
+
+    ssize_t received;
+    do {
+        received = recvmsg(connection, &header, MSG_CMSG_CLOEXEC);
+    } while (received == -1 && errno == EINTR);
+    *fd = -1;
+    for (struct cmsghdr* descriptor = CMSG_FIRSTHDR(&header); descriptor != NULL; descriptor = CMSG_NXTHDR(&header, descriptor)) {
+        if (descriptor->cmsg_level == SOL_SOCKET && descriptor->cmsg_type == SCM_RIGHTS) memcpy(fd, CMSG_DATA(descriptor), sizeof(int));
+    }
+    if (received == 0) return 0;
+    if (received != (ssize_t)size || (header.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) return -1;
+    return 1;
+}
+
+/*
+ * Compress the bitmap of 'size' bytes in the memfd 'bitmapFd' into a new sealed memfd stored in 'outputFd'
+ */
+static uint8_t encodeRequest(bmpRleContext* context, const int bitmapFd, const size_t size, int* outputFd, size_t* outputSize) {
+    struct stat bitmapStat;
+    if (fstat(bitmapFd, &bitmapStat) == -1 || (size_t)bitmapStat.st_size < size) return ERROR_INVALID_ARGUMENT;
+    if (size < MIN_BITMAP_SIZE) return ERROR_TOO_SMALL;
+    // a bitmap that can shrink while it is read would end the daemon with SIGBUS, pixels rewritten
+    // between the measure and the encode pass of V6 would overflow the exactly sized output buffer
+    const int seals = fcntl(bitmapFd, F_GET_SEALS);
+    if (seals == -1 || (seals & REQUIRED_SEALS) != REQUIRED_SEALS) return ERROR_INVALID_ARGUMENT;
+
+    const uint8_t* bitmap = mmap(NULL, size, PROT_READ, MAP_SHARED | MAP_POPULATE, bitmapFd, 0);
+    if (bitmap == MAP_FAILED) return ERROR_NO_MEMORY;
+    const uint8_t* output;
+    uint8_t code = bmpRleEncodeBitmap(context, bitmap, size, NULL, &output, outputSize);
+    munmap((void*)bitmap, size);
+    if (code != SUCCESS_BITMAP_VALIDATION) return code;
+
+    // written from the warm output buffer of the context, the pages of the memfd are allocated by the kernel on the way
+    *outputFd = memfd_create("bmpRle", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (*outputFd == -1) return ERROR_NO_MEMORY;
+    size_t written = 0;
+    while (written < *outputSize) {
+        const ssize_t part = write(*outputFd, output + written, *outputSize - written);
+        if (part == -1 && errno == EINTR) continue;
+        if (part <= 0) break;
+        written += part;
+    }
+    if (written < *outputSize || fcntl(*outputFd, F_ADD_SEALS, OUTPUT_SEALS) == -1) {
+        close(*outputFd);
+        return ERROR_NO_MEMORY;
+    }
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+/*
+ * Answer the requests of 'connection' until the client closes it
+ */
+static void serveConnection(bmpRleContext* context, const int connection) {
+    while (1) {
+        struct daemonRequest request;
+        int bitmapFd;
+        const int status = receiveMessage(connection, &request, sizeof(request), &bitmapFd);
+        if (status == 0) break;
+
+        struct daemonReply reply = { ERROR_INVALID_ARGUMENT, 0, 0 };
+        int outputFd = -1;
+        if (status == 1 && request.magic == DAEMON_MAGIC && bitmapFd != -1) {
+            size_t outputSize = 0;
+            reply.code = encodeRequest(context, bitmapFd, request.size, &outputFd, &outputSize);
+            reply.size = outputSize;
+        }
+        if (bitmapFd != -1) close(bitmapFd);
+        if (reply.code != SUCCESS_BITMAP_VALIDATION) outputFd = -1;
+
+        const uint8_t isSent = sendMessage(connection, &reply, sizeof(reply), outputFd);
+        // the client holds its own reference to the compressed bitmap
+        if (outputFd != -1) close(outputFd);
+        if (!isSent || status == -1) break;
+    }
+}
+
+static void* runWorker(void* arg) {
+    struct daemonWorker* worker = arg;
+    while (1) {
+        const int connection = accept4(worker->listenSocket, NULL, NULL, SOCK_CLOEXEC);
+        if (connection == -1) {
+            // a connection aborted before it was accepted or an interrupt, the worker keeps accepting
+            if (errno != EINTR && errno != ECONNABORTED) perror("Error while accepting connection");
+            continue;
+        }
+        serveConnection(worker->context, connection);
+        close(connection);
+    }
+    return NULL;
+}
+
+/*
+ * Compress the bitmaps of the clients of 'socketFile' with 'versionNumber' on 'threadCount' workers until SIGINT or SIGTERM
+ */
+void bmpRleDaemon(const char* socketFile, long versionNumber, size_t threadCount) {
+    struct sockaddr_un address = { 0 };
+    address.sun_family = AF_UNIX;
+    if (strlen(socketFile) >= sizeof(address.sun_path)) throwError("Socket path(--daemon) is too long");
+    strcpy(address.sun_path, socketFile);
+
+    const int listenSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listenSocket == -1) throwSystemError("Error while creating socket");
+    // a socket file left behind by an earlier daemon is replaced
+    unlink(socketFile);
+    if (bind(listenSocket, (struct sockaddr*)&address, sizeof(address)) == -1) throwSystemError("Error while binding socket");
+    if (listen(listenSocket, DAEMON_BACKLOG) == -1) throwSystemError("Error while listening on socket");
+
+    // the workers inherit the blocked signals, only the calling thread waits for them
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+
+    struct daemonWorker* workers = malloc(sizeof(struct daemonWorker) * threadCount);
+    if (workers == NULL) throwSystemError("Error while allocating memory");
+    for (size_t i = 0; i < threadCount; i++) {
+        workers[i].listenSocket = listenSocket;
+        uint8_t code = bmpRleCreateContext(&workers[i].context, versionNumber, 1);
+        if (code == SUCCESS_BITMAP_VALIDATION) code = bmpRleReserveContext(workers[i].context, DAEMON_RESERVED_WIDTH, DAEMON_RESERVED_HEIGHT);
+        if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, runWorker, &workers[i]) != 0) throwSystemError("Error while creating worker");
+        pthread_detach(thread);
+    }
+    printf("Listening on %s with %zu workers\n", socketFile, threadCount);
+    fflush(stdout);
+
+    int signal;
+    sigwait(&stopSignals, &signal);
+    // workers end with the process, a request in flight is dropped
+    close(listenSocket);
+    unlink(socketFile);
+}
+
+/*
+ * Compress 'inputFile' by the daemon listening on 'socketFile' and write the compressed bitmap to 'outputFile' ('-' for stdout)
+ * the bitmap is sent 'runs' times over one connection, for more than one run the mean latency of a request is reported
+ */
+void bmpRleConnect(const char* socketFile, const char* inputFile, const char* outputFile, long runs) {
+    struct sockaddr_un address = { 0 };
+    address.sun_family = AF_UNIX;
+    if (strlen(socketFile) >= sizeof(address.sun_path)) throwError("Socket path(--connect) is too long");
+    strcpy(address.sun_path, socketFile);
+
+    // the bitmap is copied into a sealed memfd once and handed over for every run
+    FILE* ptrIn = fopen(inputFile, "r");
+    if (ptrIn == NULL) throwSystemError("Error while opening input file");
+    const int bitmapFd = memfd_create("bmpRle", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (bitmapFd == -1) throwSystemError("Error while creating shared memory");
+    uint8_t buffer[65536];
+    size_t size = 0;
+    size_t part;
+    while ((part = fread(buffer, 1, sizeof(buffer), ptrIn)) > 0) {
+        if (write(bitmapFd, buffer, part) != (ssize_t)part) throwSystemError("Error while writing shared memory");
+        size += part;
+    }
+    if (ferror(ptrIn)) throwSystemError("Error while reading input file");
+    fclose(ptrIn);
+    if (fcntl(bitmapFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) == -1) throwSystemError("Error while sealing shared memory");
+
+    const int connection = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (connection == -1) throwSystemError("Error while creating socket");
+    if (connect(connection, (struct sockaddr*)&address, sizeof(address)) == -1) throwSystemError("Error while connecting to daemon");
+
+    struct daemonRequest request = { DAEMON_MAGIC, 0, size };
+    struct daemonReply reply;
+    int outputFd = -1;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < runs; i++) {
+        if (outputFd != -1) close(outputFd);
+        if (!sendMessage(connection, &request, sizeof(request), bitmapFd)) throwSystemError("Error while sending request");
+        if (receiveMessage(connection, &reply, sizeof(reply), &outputFd) != 1) throwError("The daemon closed the connection");
+        if (reply.code != SUCCESS_BITMAP_VALIDATION) throwValidationError(reply.code);
+        if (outputFd == -1) throwError("The daemon sent no compressed bitmap");
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    close(connection);
+    close(bitmapFd);
+
+    // the compressed bitmap is read straight from the shared memory of the daemon
+    const uint8_t* output = mmap(NULL, reply.size, PROT_READ, MAP_SHARED, outputFd, 0);
+    if (output == MAP_FAILED) throwSystemError("Error while mapping compressed bitmap");
+    const uint8_t isStdout = strcmp(outputFile, "-") == 0;
+    FILE* ptrOut = isStdout ? stdout : fopen(outputFile, "w");
+    if (ptrOut == NULL) throwSystemError("Error while opening output file");
+    if (fwrite(output, reply.size, 1, ptrOut) != 1) throwSystemError("Error while writing output file");
+    if (!isStdout) fclose(ptrOut);
+    munmap((void*)output, reply.size);
+    close(outputFd);
+
+    if (runs > 1) {
+        // the report must not mix with a bitmap written to stdout
+        const double nanoseconds = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+        fprintf(isStdout ? stderr : stdout, "%ld requests, %.1f us per bitmap\n", runs, nanoseconds / runs / 1e3);
+    }
+}
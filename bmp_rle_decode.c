@@ -0,0 +1,210 @@
+/*
+ * SIMD Optimized Decoder of RLE_8 and RLE_4
+ * Runs are filled and absolute blocks are copied with 16 byte vector stores,
+ * the last vector of a run or block overlaps the previous one instead of writing past its end
+ */
+
+#include <stdint.h> // uint
+#include <memory.h> // memset, memcpy
+#include <emmintrin.h> // SIMD
+#include "bitmap.h"
+
+/*
+ * Fill 'count' pixels with 'pixel'
+ */
+static inline void fillRun(uint8_t* outPixelPointer, const uint8_t pixel, const size_t count) {
+    if (count < 16) {
+        memset(outPixelPointer, pixel, count);
+        return;
+    }
+    const __m128i pixels = _mm_set1_epi8((char)pixel);
+    for (size_t i = 0; i + 16 <= count; i += 16) {
+        _mm_storeu_si128((__m128i_u*)(outPixelPointer + i), pixels);
+    }
+    _mm_storeu_si128((__m128i_u*)(outPixelPointer + count - 16), pixels);
+}
+
+/*
+ * Copy 'count' pixels of an absolute block
+ */
+static inline void copyAbsolute(uint8_t* outPixelPointer, const uint8_t* inPixelPointer, const size_t count) {
+    if (count < 16) {
+        memcpy(outPixelPointer, inPixelPointer, count);
+        return;
+    }
+    for (size_t i = 0; i + 16 <= count; i += 16) {
+        _mm_storeu_si128((__m128i_u*)(outPixelPointer + i), _mm_loadu_si128((const __m128i_u*)(inPixelPointer + i)));
+    }
+    _mm_storeu_si128((__m128i_u*)(outPixelPointer + count - 16), _mm_loadu_si128((const __m128i_u*)(inPixelPointer + count - 16)));
+}
+
+/*
+ * Decode 'rleSize' bytes of RLE_8 pixel data into the uncompressed (32 bit padded) pixel data 'imgOut'
+ * pixels skipped by delta escapes or end of line keep the content of 'imgOut'
+ * returns 'SUCCESS_BITMAP_VALIDATION' or 'ERROR_CORRUPT_RLE_DATA' if the data is outside of the bitmap
+ */
+uint8_t bmpRleDecode(const uint8_t* rleData, size_t rleSize, size_t width, size_t height, uint8_t* imgOut) {
+    const size_t lineSize = width + getBitmapPaddingFromWidth(width);
+    const uint8_t* end = rleData + rleSize;
+    size_t x = 0;
+    size_t y = 0;
+
+    // a missing end of bitmap is treated like the end of the data
+    while (end - rleData >= 2) {
+        const uint8_t count = *rleData++;
+        const uint8_t value = *rleData++;
+
+        if (count > 0) {
+            // encoded mode [count pixel]
+            if (y >= height || x + count > width) return ERROR_CORRUPT_RLE_DATA;
+            fillRun(imgOut + y * lineSize + x, value, count);
+            x += count;
+        }
+        else if (value == END_OF_LINE_BYTE) {
+            y++;
+            x = 0;
+        }
+        else if (value == END_OF_BITMAP_BYTE) {
+            break;
+        }
+        else if (value == DELTA_BYTE) {
+            // delta [00 02 dx dy]
+            if (end - rleData < 2) return ERROR_CORRUPT_RLE_DATA;
+            x += *rleData++;
+            y += *rleData++;
+            if (x > width || (y >= height && x > 0)) return ERROR_CORRUPT_RLE_DATA;
+        }
+        else {
+            // absolute mode [00 count pixel1 pixel2 ...] padded to 2 bytes
+            const size_t paddedCount = value + value % 2;
+            if (y >= height || x + value > width || (size_t)(end - rleData) < paddedCount) return ERROR_CORRUPT_RLE_DATA;
+            copyAbsolute(imgOut + y * lineSize + x, rleData, value);
+            rleData += paddedCount;
+            x += value;
+        }
+    }
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+static inline void setPixel4(uint8_t* line, const size_t index, const uint8_t pixel) {
+    uint8_t* byte = line + index / 2;
+    *byte = index % 2 == 0 ? (*byte & 0x0F) | pixel << 4 : (*byte & 0xF0) | pixel;
+}
+
+/*
+ * Fill 'count' pixels starting at pixel 'x' with the repeated pair 'pair' (high nibble first)
+ */
+static inline void fillRun4(uint8_t* line, size_t x, const uint8_t pair, size_t count) {
+    uint8_t nextPair = pair;
+    if (x % 2 == 1) {
+        // first pixel completes a byte, the pair continues swapped
+        setPixel4(line, x++, pair >> 4);
+        nextPair = (uint8_t)(pair << 4 | pair >> 4);
+        count--;
+    }
+    fillRun(line + x / 2, nextPair, count / 2);
+    if (count % 2 == 1) {
+        setPixel4(line, x + count - 1, nextPair >> 4);
+    }
+}
+
+/*
+ * Copy 'count' pixels of an absolute block (packed as pairs) to pixel 'x'
+ */
+static inline void copyAbsolute4(uint8_t* line, const size_t x, const uint8_t* inPixelPointer, const size_t count) {
+    if (x % 2 == 0) {
+        copyAbsolute(line + x / 2, inPixelPointer, count / 2);
+        if (count % 2 == 1) setPixel4(line, x + count - 1, inPixelPointer[count / 2] >> 4);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        setPixel4(line, x + i, i % 2 == 0 ? inPixelPointer[i / 2] >> 4 : inPixelPointer[i / 2] & 0x0F);
+    }
+}
+
+/*
+ * Decode 'rleSize' bytes of RLE_4 pixel data into the uncompressed (32 bit padded) 4bpp pixel data 'imgOut'
+ * pixels skipped by delta escapes or end of line keep the content of 'imgOut'
+ * returns 'SUCCESS_BITMAP_VALIDATION' or 'ERROR_CORRUPT_RLE_DATA' if the data is outside of the bitmap
+ */
+uint8_t bmpRle4Decode(const uint8_t* rleData, size_t rleSize, size_t width, size_t height, uint8_t* imgOut) {
+    const size_t lineSize = getBitmapLineSize(width, BITS_PER_PIXEL_RLE4);
+    const uint8_t* end = rleData + rleSize;
+    size_t x = 0;
+    size_t y = 0;
+
+    // a missing end of bitmap is treated like the end of the data
+    while (end - rleData >= 2) {
+        const uint8_t count = *rleData++;
+        const uint8_t value = *rleData++;
+
+        if (count > 0) {
+            // encoded mode [count pixel1pixel2]
+            if (y >= height || x + count > width) return ERROR_CORRUPT_RLE_DATA;
+            fillRun4(imgOut + y * lineSize, x, value, count);
+            x += count;
+        }
+        else if (value == END_OF_LINE_BYTE) {
+            y++;
+            x = 0;
+        }
+        else if (value == END_OF_BITMAP_BYTE) {
+            break;
+        }
+        else if (value == DELTA_BYTE) {
+            // delta [00 02 dx dy]
+            if (end - rleData < 2) return ERROR_CORRUPT_RLE_DATA;
+            x += *rleData++;
+            y += *rleData++;
+            if (x > width || (y >= height && x > 0)) return ERROR_CORRUPT_RLE_DATA;
+        }
+        else {
+            // absolute mode [00 count pixel1pixel2 ...] padded to 2 bytes
+            const size_t bytes = (value + 1) / 2;
+            const size_t paddedBytes = bytes + bytes % 2;
+            if (y >= height || x + value > width || (size_t)(end - rleData) < paddedBytes) return ERROR_CORRUPT_RLE_DATA;
+            copyAbsolute4(imgOut + y * lineSize, x, rleData, value);
+            rleData += paddedBytes;
+            x += value;
+        }
+    }
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+/*
+ * Find the first token of every scan line in the RLE_8 pixel data 'rleData', 'rowOffsets' has 'height' + 1 entries
+ * the tokens of scan line i (counted from the bottom) are [rowOffsets[i], rowOffsets[i + 1]) inclusive its end of line,
+ * rowOffsets[height] is the size of the pixel data inclusive end of bitmap
+ * returns 'ERROR_NOT_INDEXABLE' unless every scan line but the last ends with an end of line and the last with the end of bitmap
+ * (pixel data with delta escapes, -D and -R, has no such scan lines)
+ */
+uint8_t bmpRleIndexRows(const uint8_t* rleData, size_t rleSize, size_t height, size_t* rowOffsets) {
+    size_t offset = 0;
+    size_t y = 0;
+    rowOffsets[0] = 0;
+
+    while (offset + 2 <= rleSize) {
+        const uint8_t count = rleData[offset];
+        const uint8_t value = rleData[offset + 1];
+        offset += 2;
+
+        if (count > 0) continue;
+        if (value == END_OF_LINE_BYTE) {
+            if (++y >= height) return ERROR_NOT_INDEXABLE;
+            rowOffsets[y] = offset;
+        }
+        else if (value == END_OF_BITMAP_BYTE) {
+            if (y + 1 != height) return ERROR_NOT_INDEXABLE;
+            rowOffsets[height] = offset;
+            return SUCCESS_BITMAP_VALIDATION;
+        }
+        else if (value == DELTA_BYTE) {
+            return ERROR_NOT_INDEXABLE;
+        }
+        else {
+            // absolute mode, padded to 2 bytes
+            offset += value + value % 2;
+        }
+    }
+    return ERROR_NOT_INDEXABLE;
+}
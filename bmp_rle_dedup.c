@@ -0,0 +1,170 @@
+/*
+ * Duplicate scan line reuse
+ * Every version encodes a scan line independent of the others, so a scan line equal to an earlier one
+ * has the same tokens. Scan lines are hashed with SSE2 and a hash match is confirmed with memcmp,
+ * the tokens of a repeated scan line are copied from the first occurrence instead of encoding it again
+ * Scan lines repeated later are encoded on their own, so their tokens can be found, runs of the other
+ * scan lines are still encoded with one call of the version
+ * If the first scan lines have no duplicate, the bitmap is encoded without reuse after hashing only these
+ * into a table on the stack, the tables of all scan lines are only allocated for bitmaps with duplicates
+ */
+
+#include <stdint.h> // uint
+#include <stdlib.h> // malloc
+#include <memory.h> // memcpy, memcmp
+#include <emmintrin.h> // SIMD
+#include "bitmap.h"
+
+// scan lines hashed before giving up on a bitmap without duplicates
+#define PROBE_LINES 64
+// at most half of the slots are used
+#define PROBE_SLOTS (2 * PROBE_LINES)
+#define EMPTY_SLOT SIZE_MAX
+
+struct hashSlot {
+    uint64_t hash;
+    size_t line; // first scan line with this content or 'EMPTY_SLOT'
+};
+
+struct lineRecord {
+    size_t source; // first scan line with the content of this scan line
+    uint8_t isReferenced; // a later scan line reuses its tokens
+    size_t offset; // tokens of a referenced scan line in the output, inclusive end of line
+    size_t size;
+};
+
+/*
+ * Accumulate 16 pixels into the two 64 bit lanes of 'hash' (multiply of the 32 bit halves of the keyed pixels,
+ * the pixels are added swapped, so no pixel is lost by the multiply)
+ */
+static inline __m128i accumulateBlock(const __m128i hash, const __m128i pixels) {
+    const __m128i keys = _mm_set_epi32(0x165667B1, (int)0x85EBCA77, (int)0xC2B2AE3D, 0x27D4EB2F);
+    const __m128i keyed = _mm_xor_si128(pixels, keys);
+    const __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+    return _mm_add_epi64(_mm_add_epi64(hash, product), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+static uint64_t hashLine(const uint8_t* line, const size_t width) {
+    __m128i hash = _mm_set_epi64x(0x9E3779B97F4A7C15, (long long)width);
+    size_t k = 0;
+    for (; k + 16 <= width; k += 16) {
+        hash = accumulateBlock(hash, _mm_loadu_si128((const __m128i_u*)(line + k)));
+    }
+    if (k < width) {
+        // the last pixels are read without touching the bytes behind the scan line
+        uint8_t rest[16] = { 0 };
+        memcpy(rest, line + k, width - k);
+        hash = accumulateBlock(hash, _mm_loadu_si128((const __m128i_u*)rest));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i_u*)lanes, hash);
+    uint64_t value = lanes[0] ^ (lanes[1] * 0x9E3779B97F4A7C15);
+    value ^= value >> 32;
+    return value * 0xD6E8FEB86659FD93;
+}
+
+/*
+ * Check if one of the first 'PROBE_LINES' scan lines is repeated among them
+ */
+static uint8_t hasProbeDuplicate(const uint8_t* imgIn, const size_t width, const size_t height, const ptrdiff_t stride) {
+    struct hashSlot slots[PROBE_SLOTS];
+    for (size_t i = 0; i < PROBE_SLOTS; i++) {
+        slots[i].line = EMPTY_SLOT;
+    }
+
+    const size_t lines = height < PROBE_LINES ? height : PROBE_LINES;
+    for (size_t i = 0; i < lines; i++) {
+        const uint8_t* line = imgIn + (ptrdiff_t)i * stride;
+        const uint64_t hash = hashLine(line, width);
+        size_t slot = hash & (PROBE_SLOTS - 1);
+        for (; slots[slot].line != EMPTY_SLOT; slot = (slot + 1) & (PROBE_SLOTS - 1)) {
+            if (slots[slot].hash == hash && memcmp(imgIn + (ptrdiff_t)slots[slot].line * stride, line, width) == 0) return 1;
+        }
+        slots[slot].hash = hash;
+        slots[slot].line = i;
+    }
+    return 0;
+}
+
+/*
+ * Find the first scan line equal to every scan line
+ */
+static void findDuplicates(const uint8_t* imgIn, const size_t width, const size_t height, const ptrdiff_t stride,
+    struct lineRecord* records, struct hashSlot* slots, const size_t slotMask) {
+    for (size_t i = 0; i < height; i++) {
+        const uint8_t* line = imgIn + (ptrdiff_t)i * stride;
+        const uint64_t hash = hashLine(line, width);
+        records[i].source = i;
+        records[i].isReferenced = 0;
+
+        // linear probing, a hash match is a duplicate only if the pixels are equal
+        size_t slot = hash & slotMask;
+        for (; slots[slot].line != EMPTY_SLOT; slot = (slot + 1) & slotMask) {
+            if (slots[slot].hash == hash && memcmp(imgIn + (ptrdiff_t)slots[slot].line * stride, line, width) == 0) {
+                records[i].source = slots[slot].line;
+                records[slots[slot].line].isReferenced = 1;
+                break;
+            }
+        }
+        if (records[i].source == i) {
+            slots[slot].hash = hash;
+            slots[slot].line = i;
+        }
+    }
+}
+
+/*
+ * Compress the bitmap with 'bmpRle', repeated scan lines reuse the tokens of their first occurrence
+ * the output is equal to the output of 'bmpRle'
+ */
+size_t bmpRleDedup(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData, bmpRleFunction bmpRle) {
+    if (height < 2 || !hasProbeDuplicate(imgIn, width, height, stride)) return bmpRle(imgIn, width, height, stride, rleData);
+
+    // at most half of the slots are used
+    size_t slotCount = 1;
+    while (slotCount < 2 * height) slotCount *= 2;
+    struct hashSlot* slots = malloc(sizeof(struct hashSlot) * slotCount);
+    struct lineRecord* records = malloc(sizeof(struct lineRecord) * height);
+    if (slots == NULL || records == NULL) {
+        free(slots);
+        free(records);
+        return bmpRle(imgIn, width, height, stride, rleData);
+    }
+    for (size_t i = 0; i < slotCount; i++) {
+        slots[i].line = EMPTY_SLOT;
+    }
+
+    findDuplicates(imgIn, width, height, stride, records, slots, slotCount - 1);
+    free(slots);
+
+    uint8_t* outPixelPointer = rleData;
+    size_t i = 0;
+    while (i < height) {
+        const uint8_t* line = imgIn + (ptrdiff_t)i * stride;
+        if (records[i].source != i) {
+            const struct lineRecord* source = &records[records[i].source];
+            memcpy(outPixelPointer, rleData + source->offset, source->size);
+            outPixelPointer += source->size;
+            i++;
+            continue;
+        }
+
+        // a referenced scan line on its own, otherwise every scan line up to the next duplicate or referenced one
+        size_t lines = 1;
+        if (!records[i].isReferenced) {
+            while (i + lines < height && records[i + lines].source == i + lines && !records[i + lines].isReferenced) lines++;
+        }
+        const size_t size = bmpRle(line, width, lines, stride, outPixelPointer);
+        // replace end of file by end of line, every scan line ends with end of line
+        outPixelPointer[size - 1] = END_OF_LINE_BYTE;
+        records[i].offset = outPixelPointer - rleData;
+        records[i].size = size;
+        outPixelPointer += size;
+        i += lines;
+    }
+    // end of file
+    outPixelPointer[-1] = END_OF_BITMAP_BYTE;
+
+    free(records);
+    return outPixelPointer - rleData;
+}
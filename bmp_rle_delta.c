@@ -0,0 +1,286 @@
+/*
+ * Delta Implementation of RLE
+ * The dominant pixel of the bitmap (its background) is found with a histogram,
+ * background pixels in front of and behind the content of every scan line are skipped
+ * with end of line and delta escapes [00 02 dx dy] instead of being encoded,
+ * scan lines without content cost nothing apart from the delta jumping over them
+ * The content of a scan line is encoded by the run-boundary version (V6)
+ * Skipped pixels are left untouched by decoders (index 0 in the decoder of -d), so the background is written as index 0
+ * and index 0 as the background, the caller swaps both colors of the palette (see writeBitmapMetadataForDeltaRle)
+ * The inter-frame encoder skips the pixels equal to a reference frame (the previous frame of a sequence) instead,
+ * played back over the reference the update yields the frame
+ */
+
+#include <stdint.h> // uint
+#include <stdlib.h> // malloc
+#include <emmintrin.h> // SIMD
+#include "bitmap.h"
+
+#define MAX_DELTA 255
+#define MAX_ENCODED_RUN 255
+// unchanged pixels inside of a scan line are skipped by a delta (4 bytes) from this length on, shorter ones are encoded
+#define MIN_SKIPPED_PIXELS 8
+// independent histograms, so equal neighbouring pixels don't wait for each others increment
+#define HISTOGRAM_COUNT 4
+
+/*
+ * Returns the most frequent pixel of the bitmap, the smallest one on ties
+ */
+uint8_t getDominantPixel(const uint8_t* imgIn, const size_t width, const size_t height, const ptrdiff_t stride) {
+    uint32_t histograms[HISTOGRAM_COUNT][256] = { { 0 } };
+
+    for (size_t i = 0; i < height; i++) {
+        const uint8_t* line = imgIn + (ptrdiff_t)i * stride;
+        size_t k = 0;
+        for (; k + HISTOGRAM_COUNT <= width; k += HISTOGRAM_COUNT) {
+            histograms[0][line[k]]++;
+            histograms[1][line[k + 1]]++;
+            histograms[2][line[k + 2]]++;
+            histograms[3][line[k + 3]]++;
+        }
+        for (; k < width; k++) {
+            histograms[0][line[k]]++;
+        }
+    }
+
+    uint8_t dominant = 0;
+    uint32_t maxCount = 0;
+    for (int pixel = 0; pixel < 256; pixel++) {
+        const uint32_t count = histograms[0][pixel] + histograms[1][pixel] + histograms[2][pixel] + histograms[3][pixel];
+        if (count > maxCount) {
+            maxCount = count;
+            dominant = pixel;
+        }
+    }
+    return dominant;
+}
+
+/*
+ * Returns the index of the first pixel of 'line' that is not 'background' or 'width' if there is none
+ */
+static inline size_t findContentStart(const uint8_t* line, const size_t width, const uint8_t background) {
+    const __m128i backgrounds = _mm_set1_epi8((char)background);
+    size_t k = 0;
+    for (; k + 16 <= width; k += 16) {
+        const uint32_t contentMask = (uint16_t)~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i_u*)(line + k)), backgrounds));
+        if (contentMask != 0) return k + __builtin_ctz(contentMask);
+    }
+    while (k < width && line[k] == background) k++;
+    return k;
+}
+
+/*
+ * Returns the index behind the last pixel of 'line' that is not 'background'
+ */
+static inline size_t findContentEnd(const uint8_t* line, const size_t width, const uint8_t background) {
+    const __m128i backgrounds = _mm_set1_epi8((char)background);
+    size_t k = width;
+    for (; k >= 16; k -= 16) {
+        const uint32_t contentMask = (uint16_t)~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i_u*)(line + k - 16)), backgrounds));
+        if (contentMask != 0) return k - 16 + 32 - __builtin_clz(contentMask);
+    }
+    while (k > 0 && line[k - 1] == background) k--;
+    return k;
+}
+
+/*
+ * Size of the deltas moving the cursor 'dx' pixels right and 'dy' scan lines down
+ */
+static inline size_t measureDelta(const size_t dx, const size_t dy) {
+    const size_t steps = dx > dy ? dx : dy;
+    return 4 * ((steps + MAX_DELTA - 1) / MAX_DELTA);
+}
+
+/*
+ * Write the deltas [00 02 dx dy] moving the cursor 'dx' pixels right and 'dy' scan lines down
+ */
+static inline uint8_t* writeDelta(size_t dx, size_t dy, uint8_t* outPixelPointer) {
+    while (dx > 0 || dy > 0) {
+        const uint8_t stepX = dx > MAX_DELTA ? MAX_DELTA : dx;
+        const uint8_t stepY = dy > MAX_DELTA ? MAX_DELTA : dy;
+        *outPixelPointer++ = 0;
+        *outPixelPointer++ = DELTA_BYTE;
+        *outPixelPointer++ = stepX;
+        *outPixelPointer++ = stepY;
+        dx -= stepX;
+        dy -= stepY;
+    }
+    return outPixelPointer;
+}
+
+/*
+ * Copy 'width' pixels of 'line' into 'swapped' with the indices 0 and 'background' swapped
+ */
+static inline void swapBackground(const uint8_t* line, const size_t width, const uint8_t background, uint8_t* swapped) {
+    const __m128i backgrounds = _mm_set1_epi8((char)background);
+    const __m128i zeros = _mm_setzero_si128();
+    size_t k = 0;
+    for (; k + 16 <= width; k += 16) {
+        // background ^ background is 0 and 0 ^ background the background, all other pixels stay
+        const __m128i pixels = _mm_loadu_si128((const __m128i_u*)(line + k));
+        const __m128i isSwapped = _mm_or_si128(_mm_cmpeq_epi8(pixels, backgrounds), _mm_cmpeq_epi8(pixels, zeros));
+        _mm_storeu_si128((__m128i_u*)(swapped + k), _mm_xor_si128(pixels, _mm_and_si128(isSwapped, backgrounds)));
+    }
+    for (; k < width; k++) {
+        swapped[k] = line[k] == background ? 0 : line[k] == 0 ? background : line[k];
+    }
+}
+
+/*
+ * Move the cursor from pixel 'x' of scan line 'y' to the content starting at pixel 'toX' of scan line 'toY',
+ * with the cheapest of
+ * - a delta from the cursor
+ * - an end of line (if the cursor is not at the start of a scan line) followed by a delta
+ * - an end of line and a delta to the start of scan line 'toY', followed by the 'frontSize' bytes of the encoded pixels in front of the content
+ * returns the first pixel of scan line 'toY' that still has to be encoded
+ */
+static inline size_t writeMove(const size_t x, const size_t y, const size_t toX, const size_t toY, const size_t frontSize, uint8_t** outPixelPointer) {
+    const size_t endOfLineSize = x > 0 ? 2 : 0;
+    const size_t linesAfterEndOfLine = x > 0 ? toY - y - 1 : toY - y;
+    const size_t skipSize = endOfLineSize + measureDelta(toX, linesAfterEndOfLine);
+    const size_t encodeSize = endOfLineSize + measureDelta(0, linesAfterEndOfLine) + frontSize;
+
+    if (x > 0 && toX >= x && measureDelta(toX - x, toY - y) < (skipSize < encodeSize ? skipSize : encodeSize)) {
+        *outPixelPointer = writeDelta(toX - x, toY - y, *outPixelPointer);
+        return toX;
+    }
+    if (x > 0) {
+        *(*outPixelPointer)++ = END_OF_LINE_BYTE;
+        *(*outPixelPointer)++ = END_OF_LINE_BYTE;
+    }
+    if (skipSize <= encodeSize) {
+        *outPixelPointer = writeDelta(toX, linesAfterEndOfLine, *outPixelPointer);
+        return toX;
+    }
+    *outPixelPointer = writeDelta(0, linesAfterEndOfLine, *outPixelPointer);
+    return 0;
+}
+
+/*
+ * Uses delta, absolute and encoded mode, 'background' (see getDominantPixel) is skipped and swapped with index 0
+ * returns 0 if the scan line buffer can't be allocated, the pixel data of a bitmap is never empty (end of bitmap)
+ */
+size_t bmpRleDeltaBackground(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, const uint8_t background, uint8_t* rleData) {
+    // the encoded pixels of a scan line with the background swapped, not needed if the background already is index 0
+    uint8_t* swapped = NULL;
+    if (background != 0) {
+        swapped = malloc(width);
+        if (swapped == NULL) return 0;
+    }
+    uint8_t* outPixelPointer = rleData;
+    // cursor of the decoder
+    size_t x = 0;
+    size_t y = 0;
+
+    for (size_t i = 0; i < height; i++) {
+        const uint8_t* line = imgIn + (ptrdiff_t)i * stride;
+        const size_t contentStart = findContentStart(line, width, background);
+        if (contentStart == width) {
+            // only background, skipped by the next move
+            continue;
+        }
+        const size_t contentEnd = findContentEnd(line, width, background);
+
+        // the background in front of the content is encoded in runs of 'MAX_ENCODED_RUN'
+        const size_t frontSize = 2 * ((contentStart + MAX_ENCODED_RUN - 1) / MAX_ENCODED_RUN);
+        const size_t encodeStart = writeMove(x, y, contentStart, i, frontSize, &outPixelPointer);
+        const uint8_t* encoded = line + encodeStart;
+        if (swapped != NULL) {
+            swapBackground(encoded, contentEnd - encodeStart, background, swapped);
+            encoded = swapped;
+        }
+        outPixelPointer += bmpRleBoundaryWriteLine(encoded, contentEnd - encodeStart, outPixelPointer);
+        x = contentEnd;
+        y = i;
+    }
+
+    // the background behind the last content is skipped by the end of bitmap
+    *outPixelPointer++ = END_OF_LINE_BYTE;
+    *outPixelPointer++ = END_OF_BITMAP_BYTE;
+    free(swapped);
+    return outPixelPointer - rleData;
+}
+
+// Uses delta, absolute and encoded mode, the background is the dominant pixel of the bitmap
+size_t bmpRleDelta(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) {
+    return bmpRleDeltaBackground(imgIn, width, height, stride, getDominantPixel(imgIn, width, height, stride), rleData);
+}
+
+/*
+ * Returns the index of the first pixel from 'k' on that differs from 'reference' or 'width' if there is none
+ */
+static inline size_t findChangedPixel(const uint8_t* line, const uint8_t* reference, size_t k, const size_t width) {
+    for (; k + 16 <= width; k += 16) {
+        const __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i_u*)(line + k)), _mm_loadu_si128((const __m128i_u*)(reference + k)));
+        const uint32_t changedMask = (uint16_t)~_mm_movemask_epi8(equal);
+        if (changedMask != 0) return k + __builtin_ctz(changedMask);
+    }
+    while (k < width && line[k] == reference[k]) k++;
+    return k;
+}
+
+/*
+ * Returns the index of the first pixel from 'k' on that equals 'reference' or 'width' if there is none
+ */
+static inline size_t findUnchangedPixel(const uint8_t* line, const uint8_t* reference, size_t k, const size_t width) {
+    for (; k + 16 <= width; k += 16) {
+        const __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i_u*)(line + k)), _mm_loadu_si128((const __m128i_u*)(reference + k)));
+        const uint32_t unchangedMask = _mm_movemask_epi8(equal);
+        if (unchangedMask != 0) return k + __builtin_ctz(unchangedMask);
+    }
+    while (k < width && line[k] != reference[k]) k++;
+    return k;
+}
+
+/*
+ * Returns the index behind the changed span starting at 'k', unchanged gaps shorter than 'MIN_SKIPPED_PIXELS'
+ * are part of the span, the unchanged pixels at the end of the scan line are not
+ */
+static inline size_t findSpanEnd(const uint8_t* line, const uint8_t* reference, size_t k, const size_t width) {
+    while (1) {
+        const size_t gapStart = findUnchangedPixel(line, reference, k, width);
+        if (gapStart == width) return width;
+        k = findChangedPixel(line, reference, gapStart, width);
+        if (k == width || k - gapStart >= MIN_SKIPPED_PIXELS) return gapStart;
+    }
+}
+
+// Uses delta, absolute and encoded mode, 'reference' is the bottom scan line of the previous frame
+size_t bmpRleInterFrame(const uint8_t* imgIn, const uint8_t* reference, size_t width, size_t height, ptrdiff_t stride,
+    ptrdiff_t referenceStride, uint8_t* rleData) {
+    uint8_t* outPixelPointer = rleData;
+    // cursor of the decoder
+    size_t x = 0;
+    size_t y = 0;
+
+    for (size_t i = 0; i < height; i++) {
+        const uint8_t* line = imgIn + (ptrdiff_t)i * stride;
+        const uint8_t* referenceLine = reference + (ptrdiff_t)i * referenceStride;
+        size_t spanStart = findChangedPixel(line, referenceLine, 0, width);
+        if (spanStart == width) {
+            // unchanged, skipped by the next move
+            continue;
+        }
+
+        // unchanged pixels in front of the span are not uniform, a short front is measured, a long one costs its worst case
+        const size_t frontSize = spanStart < MIN_SKIPPED_PIXELS ? bmpRleBoundaryMeasureLine(line, spanStart) : 2 * spanStart;
+        size_t encodeStart = writeMove(x, y, spanStart, i, frontSize, &outPixelPointer);
+        while (1) {
+            const size_t spanEnd = findSpanEnd(line, referenceLine, spanStart, width);
+            outPixelPointer += bmpRleBoundaryWriteLine(line + encodeStart, spanEnd - encodeStart, outPixelPointer);
+            x = spanEnd;
+            if (spanEnd == width) break;
+            // the gap behind a span is at least 'MIN_SKIPPED_PIXELS' long or reaches the end of the scan line
+            spanStart = findChangedPixel(line, referenceLine, spanEnd, width);
+            if (spanStart == width) break;
+            outPixelPointer = writeDelta(spanStart - spanEnd, 0, outPixelPointer);
+            encodeStart = spanStart;
+        }
+        y = i;
+    }
+
+    // the unchanged pixels behind the last span are skipped by the end of bitmap
+    *outPixelPointer++ = END_OF_LINE_BYTE;
+    *outPixelPointer++ = END_OF_BITMAP_BYTE;
+    return outPixelPointer - rleData;
+}
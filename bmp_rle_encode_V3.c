@@ -1,7 +1,7 @@
 #include <stdint.h>
 #include <memory.h>
 #include "bitmap.h"
-#include "util.h"
+#include "bmp_rle_scalar.h"
 
 //-------Uncompressed-----------//
 // 5x2 Example with padding bytes
@@ -12,43 +12,24 @@
 // 01 01 03 03 01 04 00 00 -> 00 00 is end of line 
 // 01 01 03 03 01 04 00 01 -> 00 01 is end of file
 
-// Uses only encoded mode
-size_t bmpRleEncodeV3(const uint8_t* imgIn, size_t width, size_t height, uint8_t* rleData) {
-
-    if (rleData == NULL) {
-        throwError("some error occured");
-    }
+/*
+ * Compare the pixels of one scan line one by one, returns its compressed size without end of line
+ */
+static inline __attribute__((always_inline)) size_t bmpRleEncodeV3Line(const uint8_t* line, size_t width, uint8_t* rleData) {
+    const uint8_t* inPixelPointer = line;
+    const uint8_t* lastPixelPointer = line + width - 1;
+    uint8_t* outPixelPointer = rleData;
 
-    uint32_t inPixelIndex = 0;
-    uint32_t outPixelIndex = 0;
-    const uint8_t bitmapPadding = getBitmapPaddingFromWidth(width);
-    const uint32_t inPixelDataSizeNoLastPadd = (width + bitmapPadding) * height - bitmapPadding;
-    const uint32_t inPixelIndexOfLastPixel = inPixelDataSizeNoLastPadd - 1;
-    /*
-    * Compare the pixels one by one in each scan line while skipping padding bytes and
-    * not going over last pixel of file(otherwise seg fault)
-    */
-    for (;inPixelIndex < inPixelDataSizeNoLastPadd; inPixelIndex++) {
+    while (inPixelPointer <= lastPixelPointer) {
         uint8_t rep = 1;
-        for (;rep < 255 && (inPixelIndex % (width + bitmapPadding)) < width - 1 &&
-            inPixelIndex < inPixelIndexOfLastPixel &&
-            imgIn[inPixelIndex] == imgIn[inPixelIndex + 1]; rep++, inPixelIndex++) {
+        for (; rep < 255 && inPixelPointer < lastPixelPointer && inPixelPointer[0] == inPixelPointer[1]; rep++, inPixelPointer++) {
         }
         //write the amount of same pixels
-        rleData[outPixelIndex++] = rep;
-        rleData[outPixelIndex++] = imgIn[inPixelIndex];
-
-        if (inPixelIndex == inPixelIndexOfLastPixel) {
-            // end of file
-            rleData[outPixelIndex++] = END_OF_LINE_BYTE;
-            rleData[outPixelIndex++] = END_OF_BITMAP_BYTE;
-        }
-        else if ((inPixelIndex % (width + bitmapPadding)) == width - 1) {
-            // end of line
-            rleData[outPixelIndex++] = END_OF_LINE_BYTE;
-            rleData[outPixelIndex++] = END_OF_LINE_BYTE;
-            inPixelIndex += bitmapPadding; // skip padding bytes and go to next scan line
-        }
+        *outPixelPointer++ = rep;
+        *outPixelPointer++ = *inPixelPointer++;
     }
-    return outPixelIndex;
+    return outPixelPointer - rleData;
 }
+
+// Uses only encoded mode
+DEFINE_SCALAR_KERNEL(bmpRleEncodeV3, bmpRleEncodeV3Line)
@@ -0,0 +1,142 @@
+/*
+ * Row index of RLE_8 pixel data
+ * Absolute mode hides where a scan line starts, so RLE_8 can only be decoded from the start.
+ * The row index stores the offset of every scan line (see bmpRleIndexRows), with it any range of
+ * scan lines is decoded on its own and bands of scan lines are decoded in parallel
+ * Sidecar format: "RIDX", the height and height + 1 offsets relative to the pixel data, all little endian uint32
+ */
+
+#include <stdint.h> // uint
+#include <stdlib.h> // malloc
+#include <memory.h> // memcpy, memcmp
+#include <pthread.h>
+#include "bitmap.h"
+
+struct decodeBand {
+    const uint8_t* rleData;
+    size_t rleSize;
+    size_t width;
+    size_t height;
+    uint8_t* imgOut;
+    uint8_t code;
+};
+
+/*
+ * Size of the row index of 'height' scan lines
+ */
+size_t getRowIndexSize(const size_t height) {
+    return ROW_INDEX_HEADER_SIZE + 4 * (height + 1);
+}
+
+/*
+ * Write the row index of the 'height' scan line offsets 'rowOffsets' into 'index' of 'getRowIndexSize' bytes
+ */
+void writeRowIndex(const size_t* rowOffsets, const size_t height, uint8_t* index) {
+    const uint32_t indexHeight = height;
+    memcpy(index, ROW_INDEX_MAGIC, 4);
+    memcpy(index + 4, &indexHeight, 4);
+    for (size_t i = 0; i <= height; i++) {
+        // the pixel data of a bitmap is below 4 GiB
+        const uint32_t offset = rowOffsets[i];
+        memcpy(index + ROW_INDEX_HEADER_SIZE + 4 * i, &offset, 4);
+    }
+}
+
+/*
+ * Read the row index 'index' of 'indexSize' bytes into 'rowOffsets' ('height' + 1 entries)
+ * returns 'ERROR_INVALID_ROW_INDEX' if it doesn't belong to pixel data of 'height' scan lines and 'rleSize' bytes
+ */
+uint8_t readRowIndex(const uint8_t* index, const size_t indexSize, const size_t height, const size_t rleSize, size_t* rowOffsets) {
+    uint32_t indexHeight;
+    if (indexSize != getRowIndexSize(height) || memcmp(index, ROW_INDEX_MAGIC, 4) != 0) return ERROR_INVALID_ROW_INDEX;
+    memcpy(&indexHeight, index + 4, 4);
+    if (indexHeight != height) return ERROR_INVALID_ROW_INDEX;
+
+    for (size_t i = 0; i <= height; i++) {
+        uint32_t offset;
+        memcpy(&offset, index + ROW_INDEX_HEADER_SIZE + 4 * i, 4);
+        rowOffsets[i] = offset;
+        // every scan line has at least its end of line
+        if (i > 0 && rowOffsets[i] < rowOffsets[i - 1] + 2) return ERROR_INVALID_ROW_INDEX;
+    }
+    if (rowOffsets[0] != 0 || rowOffsets[height] != rleSize) return ERROR_INVALID_ROW_INDEX;
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+static void* decodeBand(void* arg) {
+    struct decodeBand* band = arg;
+    band->code = bmpRleDecode(band->rleData, band->rleSize, band->width, band->height, band->imgOut);
+    return NULL;
+}
+
+/*
+ * Returns the first scan line in [first, last] starting at or behind 'offset'
+ */
+static size_t findRow(const size_t* rowOffsets, size_t first, size_t last, const size_t offset) {
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        if (rowOffsets[middle] < offset) first = middle + 1;
+        else last = middle;
+    }
+    return first;
+}
+
+/*
+ * Decode the scan lines [firstRow, firstRow + rowCount) (counted from the bottom) of the RLE_8 pixel data 'rleData'
+ * located by 'rowOffsets' into 'imgOut' (rowCount padded scan lines), only the tokens of these scan lines are read
+ * the scan lines are split into 'threadCount' bands of about the same compressed size, decoded in parallel
+ * returns 'SUCCESS_BITMAP_VALIDATION' or 'ERROR_CORRUPT_RLE_DATA'
+ */
+uint8_t bmpRleDecodeRows(const uint8_t* rleData, const size_t* rowOffsets, size_t width, size_t firstRow, size_t rowCount, uint8_t* imgOut,
+    size_t threadCount) {
+    const size_t lineSize = getBitmapLineSize(width, BITS_PER_PIXEL);
+    const size_t lastRow = firstRow + rowCount;
+    if (threadCount > rowCount) threadCount = rowCount;
+    if (threadCount == 0) threadCount = 1;
+
+    struct decodeBand* bands = malloc(sizeof(struct decodeBand) * threadCount);
+    pthread_t* threads = malloc(sizeof(pthread_t) * threadCount);
+    uint8_t* isStarted = calloc(threadCount, 1);
+    if (bands == NULL || threads == NULL || isStarted == NULL) {
+        // one band on the calling thread
+        free(bands);
+        free(threads);
+        free(isStarted);
+        struct decodeBand band = { rleData + rowOffsets[firstRow], rowOffsets[lastRow] - rowOffsets[firstRow], width, rowCount, imgOut, 0 };
+        decodeBand(&band);
+        return band.code;
+    }
+
+    // band boundaries at equal shares of the compressed size
+    const size_t start = rowOffsets[firstRow];
+    const size_t size = rowOffsets[lastRow] - start;
+    size_t bandStart = firstRow;
+    for (size_t i = 0; i < threadCount; i++) {
+        size_t bandEnd = i + 1 == threadCount ? lastRow : findRow(rowOffsets, bandStart, lastRow, start + size / threadCount * (i + 1));
+        if (bandEnd == bandStart && bandEnd < lastRow) bandEnd++;
+        bands[i].rleData = rleData + rowOffsets[bandStart];
+        bands[i].rleSize = rowOffsets[bandEnd] - rowOffsets[bandStart];
+        bands[i].width = width;
+        bands[i].height = bandEnd - bandStart;
+        bands[i].imgOut = imgOut + (bandStart - firstRow) * lineSize;
+        bands[i].code = SUCCESS_BITMAP_VALIDATION;
+        bandStart = bandEnd;
+    }
+
+    // the calling thread decodes the first band, bands of threads that can't be started are decoded afterwards
+    for (size_t i = 1; i < threadCount; i++) {
+        isStarted[i] = pthread_create(&threads[i], NULL, decodeBand, &bands[i]) == 0;
+    }
+    decodeBand(&bands[0]);
+    uint8_t code = bands[0].code;
+    for (size_t i = 1; i < threadCount; i++) {
+        if (isStarted[i]) pthread_join(threads[i], NULL);
+        else decodeBand(&bands[i]);
+        if (bands[i].code != SUCCESS_BITMAP_VALIDATION) code = bands[i].code;
+    }
+
+    free(isStarted);
+    free(threads);
+    free(bands);
+    return code;
+}
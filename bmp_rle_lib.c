@@ -0,0 +1,261 @@
+/*
+ * Encoder context of libbmprle
+ * The context keeps the selected version, the scan line sizes and the output buffer between calls,
+ * buffers are only grown, so repeated calls don't allocate
+ * Every version reads its scan lines with the stride of the caller, so pixels are never copied
+ * Updates re-encode only dirty scan lines into the output buffer and splice them into the pixel data of the caller
+ */
+
+#include <stdint.h> // uint
+#include <stdlib.h> // malloc
+#include <memory.h> // memmove, memcpy, memset
+#include "bitmap.h"
+#include "bmprle.h"
+
+struct bmpRleContext {
+    bmpRleFunction bmpRle;
+    bmpRleMeasureFunction bmpRleMeasure;
+    size_t threadCount;
+    size_t* lineSizes;
+    size_t lineSizesCapacity;
+    uint8_t* output;
+    size_t outputCapacity;
+};
+
+/*
+ * Grow 'buffer' to at least 'size' bytes, the content is not kept
+ * returns 0 if there is not enough memory
+ */
+static uint8_t reserve(void** buffer, size_t* capacity, const size_t size) {
+    if (size <= *capacity) return 1;
+    free(*buffer);
+    *buffer = malloc(size);
+    *capacity = *buffer == NULL ? 0 : size;
+    return *buffer != NULL;
+}
+
+uint8_t bmpRleCreateContext(bmpRleContext** context, long versionNumber, size_t threadCount) {
+    if (context == NULL || threadCount == 0) return ERROR_INVALID_ARGUMENT;
+    if (versionNumber == -1) versionNumber = getWidestSupportedVersion();
+    if (!isVersionSupported(versionNumber)) return ERROR_UNSUPPORTED_VERSION;
+
+    *context = calloc(1, sizeof(bmpRleContext));
+    if (*context == NULL) return ERROR_NO_MEMORY;
+    (*context)->bmpRle = getCompressionFunction(versionNumber);
+    (*context)->bmpRleMeasure = getMeasureFunction(versionNumber);
+    (*context)->threadCount = threadCount;
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+void bmpRleDestroyContext(bmpRleContext* context) {
+    if (context == NULL) return;
+    free(context->lineSizes);
+    free(context->output);
+    free(context);
+}
+
+uint8_t bmpRleReserveContext(bmpRleContext* context, size_t width, size_t height) {
+    if (context == NULL || width == 0 || height == 0) return ERROR_INVALID_ARGUMENT;
+    if (!reserve((void**)&context->lineSizes, &context->lineSizesCapacity, sizeof(size_t) * height)) return ERROR_NO_MEMORY;
+    if (!reserve((void**)&context->output, &context->outputCapacity, MAX_INFO_OFF_BITS + getMaxPixelDataSize(width, height))) return ERROR_NO_MEMORY;
+    // writing every page maps it now instead of on the first call
+    memset(context->lineSizes, 0, context->lineSizesCapacity);
+    memset(context->output, 0, context->outputCapacity);
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+/*
+ * Compress 8bpp pixels with the version of 'context' behind the first 'headerSize' bytes of the output buffer
+ * 'pixels' is the bottom scan line, 'stride' the distance to the scan line above it
+ */
+static uint8_t encodeInto(bmpRleContext* context, const uint8_t* pixels, const size_t width, const size_t height, const ptrdiff_t stride,
+    const size_t headerSize, size_t* rleSize) {
+    // the output buffer is exact if the version can measure its output
+    size_t pixelDataSize = getMaxPixelDataSize(width, height);
+    size_t* lineSizes = NULL;
+    if (context->bmpRleMeasure != NULL) {
+        if (!reserve((void**)&context->lineSizes, &context->lineSizesCapacity, sizeof(size_t) * height)) return ERROR_NO_MEMORY;
+        lineSizes = context->lineSizes;
+        pixelDataSize = context->bmpRleMeasure(pixels, width, height, stride, lineSizes);
+    }
+    if (!reserve((void**)&context->output, &context->outputCapacity, headerSize + pixelDataSize)) return ERROR_NO_MEMORY;
+
+    *rleSize = bmpRleParallel(pixels, width, height, stride, context->output + headerSize, context->bmpRle, context->threadCount, lineSizes);
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+uint8_t bmpRleEncodePixels(bmpRleContext* context, const uint8_t* pixels, size_t width, size_t height, size_t stride,
+    const uint8_t** rleData, size_t* rleSize) {
+    if (context == NULL || pixels == NULL || rleData == NULL || rleSize == NULL) return ERROR_INVALID_ARGUMENT;
+    if (width == 0 || height == 0 || stride < width || stride > PTRDIFF_MAX) return ERROR_INVALID_ARGUMENT;
+
+    const uint8_t code = encodeInto(context, pixels, width, height, stride, 0, rleSize);
+    if (code != SUCCESS_BITMAP_VALIDATION) return code;
+    *rleData = context->output;
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+uint8_t bmpRleEncodeFrame(bmpRleContext* context, const uint8_t* pixels, const uint8_t* reference, size_t width, size_t height, size_t stride,
+    const uint8_t** rleData, size_t* rleSize) {
+    if (context == NULL || pixels == NULL || reference == NULL || rleData == NULL || rleSize == NULL) return ERROR_INVALID_ARGUMENT;
+    if (width == 0 || height == 0 || stride < width || stride > PTRDIFF_MAX) return ERROR_INVALID_ARGUMENT;
+
+    if (!reserve((void**)&context->output, &context->outputCapacity, getMaxPixelDataSize(width, height))) return ERROR_NO_MEMORY;
+    *rleSize = bmpRleInterFrame(pixels, reference, width, height, stride, stride, context->output);
+    *rleData = context->output;
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+uint8_t bmpRleEncodeBitmap(bmpRleContext* context, const uint8_t* bitmap, size_t size, struct bitmapHeader* header,
+    const uint8_t** outputBitmap, size_t* outputSize) {
+    if (context == NULL || bitmap == NULL || outputBitmap == NULL || outputSize == NULL) return ERROR_INVALID_ARGUMENT;
+
+    struct bitmapHeader parsedHeader;
+    if (header == NULL) header = &parsedHeader;
+    uint8_t code = parseBitmap(bitmap, size, header);
+    if (code == ERROR_BITS_PER_PIXEL) code = parseTrueColorBitmap(bitmap, size, header);
+    if (code != SUCCESS_BITMAP_VALIDATION) return code;
+
+    const size_t width = header->width;
+    const size_t height = header->height;
+    // top-down bitmaps are compressed from their last scan line upwards
+    const uint8_t* pixels = getBottomLine(bitmap, header);
+    const ptrdiff_t stride = getBitmapStride(header);
+    const uint8_t isQuantised = header->bitCount == BITS_PER_PIXEL_24 || header->bitCount == BITS_PER_PIXEL_32;
+    const uint32_t offBits = isQuantised ? QUANTISED_OFF_BITS : calcOffBitsForRle(bitmap);
+    size_t rleSize;
+    if (isQuantised) {
+        // 24bpp and 32bpp bitmaps are quantised to the 3-3-2 palette and compressed with V6 on one thread
+        if (!reserve((void**)&context->output, &context->outputCapacity, offBits + getMaxPixelDataSize(width, height))) return ERROR_NO_MEMORY;
+        bmpRleFunction bmpRleQuantise = header->bitCount == BITS_PER_PIXEL_24 ? bmpRleQuantise24 : bmpRleQuantise32;
+        rleSize = bmpRleQuantise(pixels, width, height, stride, context->output + offBits);
+        if (rleSize == 0) return ERROR_NO_MEMORY;
+    }
+    else if (header->bitCount == BITS_PER_PIXEL_RLE4) {
+        // 4bpp bitmaps are compressed with RLE_4 on one thread, independent of the version of the context
+        if (!reserve((void**)&context->output, &context->outputCapacity, offBits + getMaxPixelDataSize(width, height))) return ERROR_NO_MEMORY;
+        rleSize = bmpRle4(pixels, width, height, stride, context->output + offBits);
+    }
+    else {
+        code = encodeInto(context, pixels, width, height, stride, offBits, &rleSize);
+        if (code != SUCCESS_BITMAP_VALIDATION) return code;
+    }
+
+    if (!isRleSizeValid(offBits, rleSize)) return ERROR_TOO_LARGE;
+    if (isQuantised) writeBitmapMetadataForQuantisedRle(bitmap, context->output);
+    else writeBitmapMetadataForRle(bitmap, context->output);
+    *outputSize = writeBitmapSizesForRle(context->output, offBits, rleSize);
+    *outputBitmap = context->output;
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+/*
+ * Splice the re-encoded 'ranges' into 'rleData', fails if the updated pixel data exceeds 'capacity' or 'maxSize'
+ */
+static uint8_t updateInto(bmpRleContext* context, const uint8_t* pixels, const size_t width, const size_t height, const size_t stride,
+    const struct bmpRleRowRange* ranges, const size_t rangeCount, uint8_t* rleData, size_t* rleSize, const size_t capacity,
+    const size_t maxSize, size_t* rowOffsets) {
+    if (width == 0 || height == 0 || stride < width || stride > PTRDIFF_MAX || rowOffsets[height] != *rleSize) return ERROR_INVALID_ARGUMENT;
+    size_t encodedCapacity = 0;
+    size_t offsetCount = 0;
+    for (size_t k = 0; k < rangeCount; k++) {
+        if (ranges[k].first >= height || ranges[k].count == 0 || ranges[k].count > height - ranges[k].first) return ERROR_INVALID_ARGUMENT;
+        if (k > 0 && ranges[k].first < ranges[k - 1].first + ranges[k - 1].count) return ERROR_INVALID_ARGUMENT;
+        encodedCapacity += getMaxPixelDataSize(width, ranges[k].count);
+        offsetCount += ranges[k].count + 1;
+    }
+    if (!reserve((void**)&context->output, &context->outputCapacity, encodedCapacity)) return ERROR_NO_MEMORY;
+    if (!reserve((void**)&context->lineSizes, &context->lineSizesCapacity, sizeof(size_t) * offsetCount)) return ERROR_NO_MEMORY;
+
+    // encode the ranges one after the other, the scan line offsets of every range (relative to the range) follow each other as well
+    size_t newSize = *rleSize;
+    uint8_t* encoded = context->output;
+    size_t* encodedOffsets = context->lineSizes;
+    for (size_t k = 0; k < rangeCount; k++) {
+        const size_t first = ranges[k].first;
+        const size_t count = ranges[k].count;
+        const size_t size = bmpRleParallel(pixels + first * stride, width, count, stride, encoded, context->bmpRle, context->threadCount, NULL);
+        bmpRleIndexRows(encoded, size, count, encodedOffsets);
+        if (first + count < height) {
+            // replace end of file by end of line, the scan lines behind the range continue the bitmap
+            encoded[size - 1] = END_OF_LINE_BYTE;
+        }
+        newSize = newSize - (rowOffsets[first + count] - rowOffsets[first]) + size;
+        encoded += size;
+        encodedOffsets += count + 1;
+    }
+    if (newSize > capacity) return ERROR_BUFFER_TOO_SMALL;
+    if (newSize > maxSize) return ERROR_TOO_LARGE;
+
+    // the pixel data behind a range moves by the growth of all ranges up to it, data moving left is moved front to back
+    // and data moving right back to front, so every byte is moved once without overwriting data not moved yet
+    ptrdiff_t shift = 0;
+    encodedOffsets = context->lineSizes;
+    for (size_t k = 0; k < rangeCount; k++) {
+        const size_t end = ranges[k].first + ranges[k].count;
+        shift += (ptrdiff_t)encodedOffsets[ranges[k].count] - (ptrdiff_t)(rowOffsets[end] - rowOffsets[ranges[k].first]);
+        const size_t cleanEnd = k + 1 < rangeCount ? rowOffsets[ranges[k + 1].first] : *rleSize;
+        if (shift < 0) memmove(rleData + rowOffsets[end] + shift, rleData + rowOffsets[end], cleanEnd - rowOffsets[end]);
+        encodedOffsets += ranges[k].count + 1;
+    }
+    for (size_t k = rangeCount; k-- > 0;) {
+        const size_t end = ranges[k].first + ranges[k].count;
+        encodedOffsets -= ranges[k].count + 1;
+        const size_t cleanEnd = k + 1 < rangeCount ? rowOffsets[ranges[k + 1].first] : *rleSize;
+        if (shift > 0) memmove(rleData + rowOffsets[end] + shift, rleData + rowOffsets[end], cleanEnd - rowOffsets[end]);
+        shift -= (ptrdiff_t)encodedOffsets[ranges[k].count] - (ptrdiff_t)(rowOffsets[end] - rowOffsets[ranges[k].first]);
+    }
+
+    // copy the ranges into the gaps and shift the offsets of the following scan lines
+    encoded = context->output;
+    size_t row = rangeCount > 0 ? ranges[0].first : height + 1;
+    for (size_t k = 0; k < rangeCount; k++) {
+        const size_t first = ranges[k].first;
+        const size_t count = ranges[k].count;
+        for (; row < first; row++) {
+            rowOffsets[row] += shift;
+        }
+        const size_t start = rowOffsets[first] + shift;
+        const size_t oldSize = rowOffsets[first + count] - rowOffsets[first];
+        memcpy(rleData + start, encoded, encodedOffsets[count]);
+        for (size_t i = 0; i < count; i++) {
+            rowOffsets[first + i] = start + encodedOffsets[i];
+        }
+        shift += (ptrdiff_t)encodedOffsets[count] - (ptrdiff_t)oldSize;
+        encoded += encodedOffsets[count];
+        encodedOffsets += count + 1;
+        row = first + count;
+    }
+    for (; row <= height; row++) {
+        rowOffsets[row] += shift;
+    }
+    *rleSize = newSize;
+    return SUCCESS_BITMAP_VALIDATION;
+}
+
+uint8_t bmpRleUpdatePixels(bmpRleContext* context, const uint8_t* pixels, size_t width, size_t height, size_t stride,
+    const struct bmpRleRowRange* ranges, size_t rangeCount, uint8_t* rleData, size_t* rleSize, size_t capacity, size_t* rowOffsets) {
+    if (context == NULL || pixels == NULL || (ranges == NULL && rangeCount > 0) || rleData == NULL || rleSize == NULL || rowOffsets == NULL) {
+        return ERROR_INVALID_ARGUMENT;
+    }
+    return updateInto(context, pixels, width, height, stride, ranges, rangeCount, rleData, rleSize, capacity, SIZE_MAX, rowOffsets);
+}
+
+uint8_t bmpRleUpdateBitmap(bmpRleContext* context, const uint8_t* pixels, size_t stride, const struct bmpRleRowRange* ranges, size_t rangeCount,
+    uint8_t* bitmap, size_t* size, size_t capacity, size_t* rowOffsets) {
+    if (context == NULL || pixels == NULL || (ranges == NULL && rangeCount > 0) || bitmap == NULL || size == NULL || rowOffsets == NULL) {
+        return ERROR_INVALID_ARGUMENT;
+    }
+    const uint8_t code = validateRleBitmap(bitmap, *size);
+    if (code != SUCCESS_BITMAP_VALIDATION) return code;
+    if (getBitCount(bitmap) != BITS_PER_PIXEL) return ERROR_BITS_PER_PIXEL;
+
+    const uint32_t offBits = getOffBits(bitmap);
+    if (capacity < offBits) return ERROR_BUFFER_TOO_SMALL;
+    size_t rleSize = *size - offBits;
+    const uint8_t updateCode = updateInto(context, pixels, getWidth(bitmap), getHeight(bitmap), stride, ranges, rangeCount,
+        bitmap + offBits, &rleSize, capacity - offBits, MAX_BITMAP_FILE_SIZE - offBits, rowOffsets);
+    if (updateCode != SUCCESS_BITMAP_VALIDATION) return updateCode;
+    *size = writeBitmapSizesForRle(bitmap, offBits, rleSize);
+    return SUCCESS_BITMAP_VALIDATION;
+}
@@ -0,0 +1,141 @@
+/*
+ * Size-optimal Implementation of RLE
+ * Every scan line is tokenised with the minimum number of bytes by dynamic programming over its suffixes:
+ * cost[i] is the smallest size of pixels [i,width), a token starting at i is either
+ * encoded mode [count pixel] (2 bytes, the longest run starting at i is always best, as cost never increases towards the end)
+ * or absolute mode [00 count pixels...] of 3 to 255 pixels (2 + count bytes plus the padding byte of odd counts)
+ * The best absolute mode token is the minimum of cost[j] + j over the window j in [i + 3, i + 255],
+ * kept per parity of j in a monotone queue, so every scan line is tokenised in linear time
+ */
+
+#include <stdint.h> // uint
+#include <stdlib.h> // malloc
+#include <memory.h> // memcpy
+#include "bitmap.h"
+
+#define MAX_ENCODED_RUN 255
+#define MIN_ABSOLUTE_COUNT 3
+#define MAX_ABSOLUTE_COUNT 255
+// capacity of a monotone queue, a power of 2 above the number of positions of one parity in the window
+#define QUEUE_SIZE 256
+
+// positions j of one parity, cost[j] + j increasing from front to back, j decreasing from front to back
+struct monotoneQueue {
+    size_t positions[QUEUE_SIZE];
+    unsigned front;
+    unsigned back;
+};
+
+static inline void pushPosition(struct monotoneQueue* queue, const size_t* cost, const size_t position) {
+    const size_t value = cost[position] + position;
+    while (queue->back != queue->front) {
+        const size_t last = queue->positions[(queue->back - 1) % QUEUE_SIZE];
+        if (cost[last] + last < value) break;
+        queue->back--;
+    }
+    queue->positions[queue->back++ % QUEUE_SIZE] = position;
+}
+
+/*
+ * Drop positions further than the longest absolute mode token from 'start'
+ */
+static inline void expirePositions(struct monotoneQueue* queue, const size_t start) {
+    while (queue->back != queue->front && queue->positions[queue->front % QUEUE_SIZE] > start + MAX_ABSOLUTE_COUNT) {
+        queue->front++;
+    }
+}
+
+/*
+ * Tokenise one scan line, 'tokens[i]' is the token starting at pixel i:
+ * the count of an encoded mode token or minus the count of an absolute mode token
+ */
+static void tokeniseLine(const uint8_t* line, const size_t width, size_t* cost, int16_t* tokens) {
+    struct monotoneQueue queues[2];
+    queues[0].front = queues[0].back = 0;
+    queues[1].front = queues[1].back = 0;
+    size_t runLength = 0; // equal pixels starting at i
+
+    cost[width] = 0;
+    for (size_t i = width; i-- > 0;) {
+        runLength = i + 1 < width && line[i] == line[i + 1] ? runLength + 1 : 1;
+        if (i + MIN_ABSOLUTE_COUNT <= width) {
+            pushPosition(&queues[(i + MIN_ABSOLUTE_COUNT) % 2], cost, i + MIN_ABSOLUTE_COUNT);
+        }
+
+        // encoded mode is preferred on equal cost, decoders copy it faster
+        const size_t count = runLength < MAX_ENCODED_RUN ? runLength : MAX_ENCODED_RUN;
+        size_t bestCost = cost[i + count] + 2;
+        int16_t bestToken = count;
+
+        for (int parity = 0; parity < 2; parity++) {
+            struct monotoneQueue* queue = &queues[parity];
+            expirePositions(queue, i);
+            if (queue->back == queue->front) continue;
+            const size_t end = queue->positions[queue->front % QUEUE_SIZE];
+            // odd counts need a padding byte
+            const size_t absoluteCost = cost[end] + (end - i) + 2 + (end - i) % 2;
+            if (absoluteCost < bestCost) {
+                bestCost = absoluteCost;
+                bestToken = -(int16_t)(end - i);
+            }
+        }
+        cost[i] = bestCost;
+        tokens[i] = bestToken;
+    }
+}
+
+/*
+ * Write the tokens of one scan line without end of line, returns its compressed size
+ */
+static size_t writeLine(const uint8_t* line, const size_t width, const int16_t* tokens, uint8_t* outPixelPointer) {
+    uint8_t* start = outPixelPointer;
+    for (size_t i = 0; i < width;) {
+        const int16_t token = tokens[i];
+        if (token > 0) {
+            // encoded mode [count pixel]
+            *outPixelPointer++ = token;
+            *outPixelPointer++ = line[i];
+            i += token;
+        }
+        else {
+            // absolute mode [00 count pixel1 pixel2 ...]
+            const uint8_t count = -token;
+            *outPixelPointer++ = 0;
+            *outPixelPointer++ = count;
+            memcpy(outPixelPointer, line + i, count);
+            outPixelPointer += count;
+            if (count % 2 == 1) {
+                // 2-byte alignment
+                *outPixelPointer++ = 0;
+            }
+            i += count;
+        }
+    }
+    return outPixelPointer - start;
+}
+
+// Uses absolute and encoded mode with the minimum number of bytes per scan line
+size_t bmpRleOptimal(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) {
+    size_t* cost = malloc(sizeof(size_t) * (width + 1));
+    int16_t* tokens = malloc(sizeof(int16_t) * width);
+    if (cost == NULL || tokens == NULL) {
+        // still a valid (greedy) encoding
+        free(cost);
+        free(tokens);
+        return bmpRleBoundary(imgIn, width, height, stride, rleData);
+    }
+
+    uint8_t* outPixelPointer = rleData;
+    for (size_t i = 1; i <= height; i++) {
+        tokeniseLine(imgIn, width, cost, tokens);
+        outPixelPointer += writeLine(imgIn, width, tokens, outPixelPointer);
+        *outPixelPointer++ = END_OF_LINE_BYTE;
+        // end of file or end of line
+        *outPixelPointer++ = height == i ? END_OF_BITMAP_BYTE : END_OF_LINE_BYTE;
+        imgIn += stride;
+    }
+
+    free(cost);
+    free(tokens);
+    return outPixelPointer - rleData;
+}
@@ -0,0 +1,197 @@
+/*
+ * Row parallel RLE
+ * Every scan line ends with its own end of line, so the bitmap is split into bands of scan lines
+ * which are compressed by any version on a pool of threads
+ * Every thread owns a range of bands and steals bands from the end of other ranges when it is done
+ * If the exact size of every scan line is known, bands are written directly at their final offset,
+ * otherwise they are written at their worst case offset and stitched together afterwards
+ * If the buffers of the pool can't be allocated, the bitmap is compressed on the calling thread
+ */
+
+#include <stdint.h> // uint
+#include <stdlib.h> // malloc
+#include <memory.h> // memcpy
+#include <pthread.h>
+#include <stdatomic.h>
+#include "bitmap.h"
+
+// bands per thread, more bands allow better balancing for bitmaps with uneven content
+#define BANDS_PER_THREAD 8
+
+// range [front, back) of bands packed into one word, so owner and thieves can update it with a single CAS
+#define RANGE(front, back) (((uint64_t)(back) << 32) | (uint32_t)(front))
+#define RANGE_FRONT(range) ((uint32_t)(range))
+#define RANGE_BACK(range) ((uint32_t)((range) >> 32))
+
+struct parallelJob {
+    const uint8_t* imgIn;
+    size_t width;
+    ptrdiff_t stride;
+    size_t bandCount;
+    size_t bandHeight; // scan lines per band, the last band may be smaller
+    size_t height;
+    bmpRleFunction bmpRle;
+    uint8_t* bandData; // output of every band at its worst case offset or 'rleData'
+    size_t* bandOffsets; // offset of every band in 'bandData'
+    size_t* bandSizes;
+    size_t threadCount;
+    _Atomic uint64_t* ranges; // bands owned by every thread
+};
+
+struct parallelWorker {
+    struct parallelJob* job;
+    size_t threadIndex;
+};
+
+/*
+ * Worst case size of 'lines' compressed scan lines
+ * every pixel in encoded mode (2 bytes) plus end of line
+ */
+static size_t getMaxBandSize(const size_t width, const size_t lines) {
+    return 2 * (width + 1) * lines;
+}
+
+/*
+ * Take the next band of the own range
+ */
+static long popFront(_Atomic uint64_t* range) {
+    uint64_t current = atomic_load(range);
+    while (RANGE_FRONT(current) < RANGE_BACK(current)) {
+        if (atomic_compare_exchange_weak(range, &current, RANGE(RANGE_FRONT(current) + 1, RANGE_BACK(current)))) {
+            return RANGE_FRONT(current);
+        }
+    }
+    return -1;
+}
+
+/*
+ * Steal the last band of another range
+ */
+static long popBack(_Atomic uint64_t* range) {
+    uint64_t current = atomic_load(range);
+    while (RANGE_FRONT(current) < RANGE_BACK(current)) {
+        if (atomic_compare_exchange_weak(range, &current, RANGE(RANGE_FRONT(current), RANGE_BACK(current) - 1))) {
+            return RANGE_BACK(current) - 1;
+        }
+    }
+    return -1;
+}
+
+static void compressBand(struct parallelJob* job, const size_t band) {
+    const size_t firstLine = band * job->bandHeight;
+    const size_t lines = firstLine + job->bandHeight > job->height ? job->height - firstLine : job->bandHeight;
+    uint8_t* out = job->bandData + job->bandOffsets[band];
+
+    size_t size = job->bmpRle(job->imgIn + (ptrdiff_t)firstLine * job->stride, job->width, lines, job->stride, out);
+    if (band + 1 < job->bandCount) {
+        // replace end of file by end of line, the next band continues the bitmap
+        out[size - 1] = END_OF_LINE_BYTE;
+    }
+    job->bandSizes[band] = size;
+}
+
+static void* runWorker(void* arg) {
+    struct parallelWorker* worker = arg;
+    struct parallelJob* job = worker->job;
+    long band;
+
+    // own bands first
+    while ((band = popFront(&job->ranges[worker->threadIndex])) >= 0) {
+        compressBand(job, band);
+    }
+    // then steal from the other threads
+    for (size_t i = 1; i < job->threadCount; i++) {
+        _Atomic uint64_t* victim = &job->ranges[(worker->threadIndex + i) % job->threadCount];
+        while ((band = popBack(victim)) >= 0) {
+            compressBand(job, band);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Compress the bitmap with 'bmpRle' on 'threadCount' threads
+ * 'lineSizes' is NULL or the exact size of every compressed scan line measured for 'bmpRle'
+ * returns the size of the pixel data in 'rleData'
+ */
+size_t bmpRleParallel(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData, bmpRleFunction bmpRle,
+    size_t threadCount, const size_t* lineSizes) {
+    if (threadCount > height) threadCount = height;
+    if (threadCount <= 1) return bmpRle(imgIn, width, height, stride, rleData);
+
+    struct parallelJob job;
+    job.imgIn = imgIn;
+    job.width = width;
+    job.stride = stride;
+    job.height = height;
+    job.bmpRle = bmpRle;
+    job.threadCount = threadCount;
+    job.bandCount = threadCount * BANDS_PER_THREAD < height ? threadCount * BANDS_PER_THREAD : height;
+    job.bandHeight = (height + job.bandCount - 1) / job.bandCount;
+    job.bandCount = (height + job.bandHeight - 1) / job.bandHeight;
+
+    job.bandData = lineSizes != NULL ? rleData : malloc(getMaxBandSize(width, job.bandHeight) * job.bandCount);
+    job.bandOffsets = malloc(sizeof(size_t) * job.bandCount);
+    job.bandSizes = malloc(sizeof(size_t) * job.bandCount);
+    job.ranges = malloc(sizeof(_Atomic uint64_t) * threadCount);
+    pthread_t* threads = malloc(sizeof(pthread_t) * threadCount);
+    struct parallelWorker* workers = malloc(sizeof(struct parallelWorker) * threadCount);
+    uint8_t* isStarted = calloc(threadCount, 1);
+    if (job.bandData == NULL || job.bandOffsets == NULL || job.bandSizes == NULL || job.ranges == NULL || threads == NULL || workers == NULL || isStarted == NULL) {
+        if (lineSizes == NULL) free(job.bandData);
+        free(isStarted);
+        free(workers);
+        free(threads);
+        free(job.ranges);
+        free(job.bandSizes);
+        free(job.bandOffsets);
+        return bmpRle(imgIn, width, height, stride, rleData);
+    }
+
+    // prefix sum of the scan line sizes or worst case offsets
+    size_t offset = 0;
+    for (size_t band = 0; band < job.bandCount; band++) {
+        job.bandOffsets[band] = offset;
+        if (lineSizes == NULL) {
+            offset += getMaxBandSize(width, job.bandHeight);
+            continue;
+        }
+        for (size_t line = band * job.bandHeight; line < height && line < (band + 1) * job.bandHeight; line++) {
+            offset += lineSizes[line];
+        }
+    }
+
+    // distribute the bands evenly over the threads
+    for (size_t i = 0; i < threadCount; i++) {
+        atomic_init(&job.ranges[i], RANGE(job.bandCount * i / threadCount, job.bandCount * (i + 1) / threadCount));
+        workers[i].job = &job;
+        workers[i].threadIndex = i;
+    }
+
+    // the calling thread is worker 0, bands of threads that can't be started are stolen by the others
+    for (size_t i = 1; i < threadCount; i++) {
+        isStarted[i] = pthread_create(&threads[i], NULL, runWorker, &workers[i]) == 0;
+    }
+    runWorker(&workers[0]);
+    for (size_t i = 1; i < threadCount; i++) {
+        if (isStarted[i]) pthread_join(threads[i], NULL);
+    }
+
+    size_t outPixelIndex = 0;
+    for (size_t band = 0; band < job.bandCount; band++) {
+        if (lineSizes == NULL) {
+            // stitch bands together at their prefix summed offsets
+            memcpy(rleData + outPixelIndex, job.bandData + job.bandOffsets[band], job.bandSizes[band]);
+        }
+        outPixelIndex += job.bandSizes[band];
+    }
+
+    if (lineSizes == NULL) free(job.bandData);
+    free(isStarted);
+    free(workers);
+    free(threads);
+    free(job.ranges);
+    free(job.bandSizes);
+    free(job.bandOffsets);
+    return outPixelIndex;
+}
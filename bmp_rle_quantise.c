@@ -0,0 +1,146 @@
+/*
+ * Quantisation of 24bpp and 32bpp bitmaps to 8bpp in front of RLE
+ * Every pixel is mapped to the fixed 3-3-2 palette (8 levels of red and green, 4 levels of blue, evenly spaced),
+ * a channel is rounded to its nearest level with a multiply and a shift, so 32bpp scan lines are quantised with SSE2
+ * Only one quantised scan line exists at a time, it is encoded with V6 straight after quantisation
+ */
+
+#include <stdint.h> // uint
+#include <stdlib.h> // malloc, abs
+#include <memory.h> // memset, memcpy
+#include <emmintrin.h> // SIMD
+#include "bitmap.h"
+
+#define RED_LEVELS 8
+#define GREEN_LEVELS 8
+#define BLUE_LEVELS 4
+
+/*
+ * Write the 256 RGBQuads of the 3-3-2 palette, index = red << 5 | green << 2 | blue
+ */
+static void writeQuantisePalette(uint8_t* colorPalette) {
+    for (int i = 0; i < 256; i++) {
+        *colorPalette++ = (i & 3) * 255 / (BLUE_LEVELS - 1);
+        *colorPalette++ = (i >> 2 & 7) * 255 / (GREEN_LEVELS - 1);
+        *colorPalette++ = (i >> 5) * 255 / (RED_LEVELS - 1);
+        *colorPalette++ = 0;
+    }
+}
+
+/*
+ * Write the metadata of a quantised 24bpp or 32bpp bitmap
+ * - BitmapFileHeader and a BitmapInfoHeader (converted from every other header) for 8bpp and RLE_8
+ * - the 256 colors of the 3-3-2 palette
+ * returns offBits
+ */
+uint32_t writeBitmapMetadataForQuantisedRle(const uint8_t* imgIn, uint8_t* imgOut) {
+    const uint32_t offBits = QUANTISED_OFF_BITS;
+    const uint32_t infoHeaderSize = BITMAPINFOHEADER_SIZE;
+    const int32_t width = getWidth(imgIn);
+    const int32_t height = abs(getHeight(imgIn));
+    const uint16_t planes = 1;
+    const uint16_t bitCount = BITS_PER_PIXEL;
+    const uint32_t compression = BI_RLE8;
+    const uint32_t clrUsed = 256;
+
+    memset(imgOut, 0, BITMAPFILEHEADER_SIZE + BITMAPINFOHEADER_SIZE);
+    memcpy(imgOut + BITMAP_INDEX_FILE_TYPE, imgIn + BITMAP_INDEX_FILE_TYPE, 2);
+    memcpy(imgOut + BITMAP_INDEX_OFF_BITS, &offBits, 4);
+    memcpy(imgOut + BITMAP_INDEX_INFO_SIZE, &infoHeaderSize, 4);
+    memcpy(imgOut + BITMAP_INDEX_WIDTH, &width, 4);
+    memcpy(imgOut + BITMAP_INDEX_HEIGHT, &height, 4);
+    memcpy(imgOut + BITMAP_INDEX_PLANES, &planes, 2);
+    memcpy(imgOut + BITMAP_INDEX_BIT_COUNT, &bitCount, 2);
+    memcpy(imgOut + BITMAP_INDEX_COMPRESSION, &compression, 4);
+    if (!isBitmapCoreHeader(imgIn)) {
+        // copy resolution (x and y pixels per meter)
+        memcpy(imgOut + BITMAP_INDEX_X_PELS_PER_METER, imgIn + BITMAP_INDEX_X_PELS_PER_METER, 8);
+    }
+    memcpy(imgOut + BITMAP_INDEX_CLR_USED, &clrUsed, 4);
+    writeQuantisePalette(imgOut + BITMAPFILEHEADER_SIZE + BITMAPINFOHEADER_SIZE);
+
+    return offBits;
+}
+
+/*
+ * Nearest of 'levels' evenly spaced levels of 'channel', dividing by 256 instead of 255 only moves
+ * a few channel values right between two levels to the lower one
+ */
+static inline uint8_t quantiseChannel(const uint8_t channel, const uint8_t levels) {
+    return (channel * (levels - 1) + 128) >> 8;
+}
+
+static inline uint8_t quantisePixel(const uint8_t blue, const uint8_t green, const uint8_t red) {
+    return quantiseChannel(red, RED_LEVELS) << 5 | quantiseChannel(green, GREEN_LEVELS) << 2 | quantiseChannel(blue, BLUE_LEVELS);
+}
+
+/*
+ * Quantise 4 BGRX pixels in the 32 bit lanes of 'pixels', the indices are in the low byte of every lane
+ */
+static inline __m128i quantiseBgrx(const __m128i pixels) {
+    const __m128i channelMask = _mm_set1_epi32(0xFF);
+    const __m128i rounding = _mm_set1_epi32(128);
+    const __m128i blue = _mm_and_si128(pixels, channelMask);
+    const __m128i green = _mm_and_si128(_mm_srli_epi32(pixels, 8), channelMask);
+    const __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 16), channelMask);
+    // channel * 7 and channel * 3 without a 32 bit multiply (SSE4.1)
+    const __m128i red3 = _mm_srli_epi32(_mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(red, 3), red), rounding), 8);
+    const __m128i green3 = _mm_srli_epi32(_mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(green, 3), green), rounding), 8);
+    const __m128i blue2 = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(blue, 1), blue), rounding), 8);
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(red3, 5), _mm_slli_epi32(green3, 2)), blue2);
+}
+
+static void quantiseLine32(const uint8_t* line, const size_t width, uint8_t* indices) {
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i indices0 = quantiseBgrx(_mm_loadu_si128((const __m128i_u*)(line + 4 * x)));
+        const __m128i indices1 = quantiseBgrx(_mm_loadu_si128((const __m128i_u*)(line + 4 * x + 16)));
+        const __m128i indices2 = quantiseBgrx(_mm_loadu_si128((const __m128i_u*)(line + 4 * x + 32)));
+        const __m128i indices3 = quantiseBgrx(_mm_loadu_si128((const __m128i_u*)(line + 4 * x + 48)));
+        // 32 bit lanes to bytes, every index is below 256
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(indices0, indices1), _mm_packs_epi32(indices2, indices3));
+        _mm_storeu_si128((__m128i_u*)(indices + x), packed);
+    }
+    for (; x < width; x++) {
+        indices[x] = quantisePixel(line[4 * x], line[4 * x + 1], line[4 * x + 2]);
+    }
+}
+
+static void quantiseLine24(const uint8_t* line, const size_t width, uint8_t* indices) {
+    for (size_t x = 0; x < width; x++) {
+        indices[x] = quantisePixel(line[3 * x], line[3 * x + 1], line[3 * x + 2]);
+    }
+}
+
+/*
+ * Quantise every scan line with 'quantiseLine' into one line buffer and encode it with V6
+ * returns 0 if the line buffer can't be allocated, the pixel data of a bitmap is never empty (end of bitmap)
+ */
+static inline __attribute__((always_inline)) size_t bmpRleQuantise(const uint8_t* imgIn, const size_t width, const size_t height,
+    const ptrdiff_t stride, uint8_t* rleData, void(*quantiseLine)(const uint8_t*, size_t, uint8_t*)) {
+    uint8_t* indices = malloc(width);
+    if (indices == NULL) return 0;
+
+    uint8_t* outPixelPointer = rleData;
+    for (size_t i = 1; i <= height; i++) {
+        quantiseLine(imgIn, width, indices);
+        outPixelPointer += bmpRleBoundaryWriteLine(indices, width, outPixelPointer);
+        *outPixelPointer++ = END_OF_LINE_BYTE;
+        // end of file or end of line
+        *outPixelPointer++ = height == i ? END_OF_BITMAP_BYTE : END_OF_LINE_BYTE;
+        imgIn += stride;
+    }
+
+    free(indices);
+    return outPixelPointer - rleData;
+}
+
+// Quantises 24bpp pixels, uses absolute and encoded mode
+size_t bmpRleQuantise24(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) {
+    return bmpRleQuantise(imgIn, width, height, stride, rleData, quantiseLine24);
+}
+
+// Quantises 32bpp pixels, uses absolute and encoded mode
+size_t bmpRleQuantise32(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) {
+    return bmpRleQuantise(imgIn, width, height, stride, rleData, quantiseLine32);
+}
@@ -0,0 +1,56 @@
+/*
+ * Scan line loop shared by the scalar kernels (V1, V2 and V3)
+ * A kernel encodes one scan line at a time from a pointer to its first pixel, so the hot loop neither divides
+ * the pixel index by the scan line size nor checks for the last pixel of the bitmap,
+ * end of line and end of bitmap are written once per scan line and the stride only advances the line pointer
+ * 'DEFINE_SCALAR_KERNEL' instantiates the loop for common widths, in these instances the width is a constant
+ */
+
+#ifndef TEAM121_BMP_RLE_SCALAR_H
+#define TEAM121_BMP_RLE_SCALAR_H
+
+#include <stdint.h> // uint
+#include <stddef.h> // size_t
+#include "bitmap.h"
+
+/*
+ * Encode every scan line with 'encodeLine' (returning the size of the line without end of line)
+ * always inlined, so 'encodeLine' and 'width' are known where the loop is instantiated
+ */
+static inline __attribute__((always_inline)) size_t encodeScalarLines(const uint8_t* imgIn, const size_t width, const size_t height,
+    const ptrdiff_t stride, uint8_t* rleData, size_t(*encodeLine)(const uint8_t*, size_t, uint8_t*)) {
+    uint8_t* outPixelPointer = rleData;
+
+    for (size_t i = 1; i <= height; i++) {
+        outPixelPointer += encodeLine(imgIn, width, outPixelPointer);
+        *outPixelPointer++ = END_OF_LINE_BYTE;
+        // end of file or end of line
+        *outPixelPointer++ = height == i ? END_OF_BITMAP_BYTE : END_OF_LINE_BYTE;
+        imgIn += stride;
+    }
+    return outPixelPointer - rleData;
+}
+
+#define SCALAR_WIDTH_CASE(constantWidth, encodeLine) \
+    case constantWidth: return encodeScalarLines(imgIn, constantWidth, height, stride, rleData, encodeLine);
+
+// common display widths get their own instance of the scan line loop, other widths share the generic one
+#define DEFINE_SCALAR_KERNEL(name, encodeLine) \
+    size_t name(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) { \
+        if (rleData == NULL) return 0; \
+        switch (width) { \
+        SCALAR_WIDTH_CASE(320, encodeLine) \
+        SCALAR_WIDTH_CASE(512, encodeLine) \
+        SCALAR_WIDTH_CASE(640, encodeLine) \
+        SCALAR_WIDTH_CASE(800, encodeLine) \
+        SCALAR_WIDTH_CASE(1024, encodeLine) \
+        SCALAR_WIDTH_CASE(1280, encodeLine) \
+        SCALAR_WIDTH_CASE(1366, encodeLine) \
+        SCALAR_WIDTH_CASE(1920, encodeLine) \
+        SCALAR_WIDTH_CASE(2560, encodeLine) \
+        SCALAR_WIDTH_CASE(3840, encodeLine) \
+        default: return encodeScalarLines(imgIn, width, height, stride, rleData, encodeLine); \
+        } \
+    }
+
+#endif //TEAM121_BMP_RLE_SCALAR_H
@@ -0,0 +1,187 @@
+/*
+ * Token state machine shared by the SIMD kernels (V0, V4 and V5)
+ * The kernels only differ in how many neighbouring pixels they compare at once,
+ * the comparison mask is consumed in runs of equal or different neighbours ('rleEqualRun' and 'rleDiffRun')
+ */
+
+#ifndef TEAM121_BMP_RLE_SIMD_H
+#define TEAM121_BMP_RLE_SIMD_H
+
+#include <stdint.h> // uint
+#include <stddef.h> // size_t
+#include "bitmap.h"
+
+uint32_t writeData(const uint8_t* inputData, uint8_t* rleData, uint8_t isDiff, uint8_t count);
+
+// pending pixels of a scan line: 'diff' different pixels followed by a chain of 'reps' + 1 equal pixels
+struct rleState {
+    const uint8_t* inPixelPointer; // first pixel not written yet
+    uint8_t* outPixelPointer;
+    uint32_t reps;
+    uint32_t diff;
+};
+
+static inline void rleFlushDiff(struct rleState* state) {
+    if (state->diff > 0) {
+        state->outPixelPointer += writeData(state->inPixelPointer, state->outPixelPointer, 1, state->diff);
+        state->inPixelPointer += state->diff;
+        state->diff = 0;
+    }
+}
+
+static inline void rleFlushReps(struct rleState* state) {
+    state->outPixelPointer += writeData(state->inPixelPointer, state->outPixelPointer, 0, state->reps + 1);
+    state->inPixelPointer += state->reps + 1;
+    state->reps = 0;
+}
+
+// a chain of 1 or 2 equal pixels is cheaper in absolute mode, so it is added to the diffs
+static inline void rleMergeRepsIntoDiff(struct rleState* state) {
+    if (state->diff + state->reps + 1 > 255) {
+        // write diff if maximum of diffs will be exceeded
+        rleFlushDiff(state);
+    }
+    state->diff += state->reps + 1;
+    state->reps = 0;
+}
+
+/*
+ * Process the comparison of the current pixel with its right neighbour
+ */
+static inline void rleStep(struct rleState* state, const int isEqual) {
+    if (isEqual) {
+        if (state->reps == 254) {
+            // maximum of reps reached, write 255 pixels, the neighbour starts a new chain
+            rleFlushReps(state);
+            return;
+        }
+        state->reps++;
+        if (state->reps == 2) {
+            // at least three pixel equal, write previously counted diffs before counting reps
+            rleFlushDiff(state);
+        }
+    }
+    else if (state->reps >= 2) {
+        // write previously counted reps, before counting diffs
+        rleFlushReps(state);
+    }
+    else {
+        rleMergeRepsIntoDiff(state);
+    }
+}
+
+/*
+ * Process 'count' pixels in a row that equal their right neighbour, same as 'count' times 'rleStep(state, 1)'
+ */
+static inline void rleEqualRun(struct rleState* state, uint32_t count) {
+    while (count > 0) {
+        if (state->reps == 254) {
+            rleFlushReps(state);
+            count--;
+            continue;
+        }
+        const uint32_t steps = count < 254 - state->reps ? count : 254 - state->reps;
+        if (state->reps < 2 && state->reps + steps >= 2) {
+            // the chain reaches three equal pixels, write previously counted diffs
+            rleFlushDiff(state);
+        }
+        state->reps += steps;
+        count -= steps;
+    }
+}
+
+/*
+ * Process 'count' pixels in a row that differ from their right neighbour, same as 'count' times 'rleStep(state, 0)'
+ */
+static inline void rleDiffRun(struct rleState* state, uint32_t count) {
+    rleStep(state, 0);
+    // reps is 0 now, every further pixel is added to the diffs
+    count--;
+    while (count > 0) {
+        if (state->diff == 255) {
+            rleFlushDiff(state);
+        }
+        const uint32_t steps = count < 255 - state->diff ? count : 255 - state->diff;
+        state->diff += steps;
+        count -= steps;
+    }
+}
+
+/*
+ * Process the 'vectorWidth' comparisons of 'mask' (bit k set if pixel k equals pixel k + 1),
+ * tzcnt finds the next change between equal and different neighbours,
+ * so a block of only equal or only different pixels is a single run
+ */
+static inline __attribute__((always_inline)) void rleMask(struct rleState* state, const uint64_t mask, const uint32_t vectorWidth) {
+    uint32_t k = 0;
+    while (k < vectorWidth) {
+        const uint64_t rest = mask >> k;
+        uint32_t count;
+        if (rest & 1) {
+            count = ~rest == 0 ? 64 - k : (uint32_t)__builtin_ctzll(~rest);
+            count = count < vectorWidth - k ? count : vectorWidth - k;
+            rleEqualRun(state, count);
+        }
+        else {
+            count = rest == 0 ? 64 - k : (uint32_t)__builtin_ctzll(rest);
+            count = count < vectorWidth - k ? count : vectorWidth - k;
+            rleDiffRun(state, count);
+        }
+        k += count;
+    }
+}
+
+/*
+ * Write all pending pixels of the scan line
+ */
+static inline void rleEndOfLine(struct rleState* state) {
+    if (state->reps >= 2) {
+        rleFlushReps(state);
+    }
+    else {
+        rleMergeRepsIntoDiff(state);
+        rleFlushDiff(state);
+    }
+}
+
+/*
+ * Generic SIMD kernel, 'compareBlock' compares 'vectorWidth' pixels with their right neighbours
+ * and returns a bitmask with bit k set if pixel k equals pixel k + 1
+ * always inlined, so every kernel gets its own copy with 'compareBlock' inlined for its instruction set
+ */
+static inline __attribute__((always_inline)) size_t bmpRleSimd(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride,
+    uint8_t* rleData, const uint32_t vectorWidth, uint64_t(*compareBlock)(const uint8_t*)) {
+
+    // to compare intervals of [0,n-1] with [1,n] of pixel data, we need to make sure that the 'n'th index is available
+    const size_t countBlocks = (width - 1) / vectorWidth;
+    struct rleState state = { imgIn, rleData, 0, 0 };
+
+    for (size_t i = 1; i <= height; i++) {
+        const uint8_t* line = state.inPixelPointer;
+
+        // compare 'vectorWidth' byte segments of pixels
+        for (size_t j = 0; j < countBlocks; j++) {
+            rleMask(&state, compareBlock(line + j * vectorWidth), vectorWidth);
+        }
+        // compare the rest of the scan line
+        for (size_t k = countBlocks * vectorWidth + 1; k < width; k++) {
+            rleStep(&state, line[k] == line[k - 1]);
+        }
+        rleEndOfLine(&state);
+
+        if (height == i) {
+            // end of file
+            *state.outPixelPointer++ = END_OF_LINE_BYTE;
+            *state.outPixelPointer++ = END_OF_BITMAP_BYTE;
+        }
+        else {
+            // end of line
+            *state.outPixelPointer++ = END_OF_LINE_BYTE;
+            *state.outPixelPointer++ = END_OF_LINE_BYTE;
+            state.inPixelPointer = line + stride;
+        }
+    }
+    return state.outPixelPointer - rleData;
+}
+
+#endif //TEAM121_BMP_RLE_SIMD_H
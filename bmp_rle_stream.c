@@ -0,0 +1,239 @@
+/*
+ * Streaming RLE
+ * The bitmap is read scan line by scan line from a (possibly non-seekable) stream,
+ * every scan line is encoded by the run-boundary version (V6) and written as soon as it is read,
+ * so only one scan line and its compressed form are kept in memory
+ * The file size and image size of the header are
+ * - patched after the pixel data if the output is seekable
+ * - measured by a counting pass over the input before writing if only the input is seekable
+ * - known after buffering the compressed pixel data if neither is seekable, at most 'TILE_OUTPUT_SIZE' bytes
+ * Large mapped bitmaps are written the same way in tiles of scan lines, so the output buffer is bounded
+ * by the worst case size of one tile instead of the whole bitmap
+ */
+
+#define _GNU_SOURCE // open_memstream
+#include <stdio.h> // FILE
+#include <stdlib.h> // malloc
+#include <fcntl.h> // fcntl
+#include <unistd.h> // sysconf
+#include <sys/mman.h> // madvise
+#include "bitmap.h"
+#include "util.h"
+
+static void readExactly(void* buffer, const size_t size, FILE* in) {
+    if (fread(buffer, 1, size, in) != size) throwError("Read failed");
+}
+
+static void writeExactly(const void* buffer, const size_t size, FILE* out) {
+    if (size > 0 && fwrite(buffer, size, 1, out) != 1) throwSystemError("Error while writing output file");
+}
+
+/*
+ * Check if 'stream' can be repositioned, appending streams can't be written at an earlier position
+ */
+static uint8_t isSeekable(FILE* stream) {
+    const int flags = fcntl(fileno(stream), F_GETFL);
+    if (flags == -1 || (flags & O_APPEND)) return 0;
+    return fseek(stream, 0, SEEK_CUR) == 0;
+}
+
+/*
+ * Read file header, information header and color palette into 'header' (MAX_INFO_OFF_BITS bytes)
+ * and validate them, the declared file size is trusted as the size of a stream is unknown
+ */
+static void readHeader(uint8_t* header, FILE* in) {
+    // everything up to the information header size is needed to locate the pixel data
+    readExactly(header, BITMAP_INDEX_INFO_SIZE + 4, in);
+    const uint32_t offBits = getOffBits(header);
+    if (offBits < MIN_CORE_OFF_BITS || offBits > MAX_INFO_OFF_BITS) throwValidationError(ERROR_WRONG_OFF_BITS);
+    readExactly(header + BITMAP_INDEX_INFO_SIZE + 4, offBits - BITMAP_INDEX_INFO_SIZE - 4, in);
+
+    const uint8_t code = validateBitmap(header, getFileSize(header));
+    if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+    if (getBitCount(header) != BITS_PER_PIXEL) throwError("Streaming is only supported for 8bpp bitmaps");
+    // the bottom scan line is compressed first, but a top-down bitmap stores it last
+    if (getHeight(header) < 0) throwError("Streaming is not supported for top down bitmaps");
+}
+
+/*
+ * Read, encode and write every scan line, returns the size of the written pixel data
+ * 'line' holds one scan line inclusive padding, 'rleLine' one compressed scan line
+ * fails if the pixel data exceeds 'maxPixelDataSize' bytes
+ */
+static size_t streamLines(FILE* in, FILE* out, const size_t width, const size_t height, uint8_t* line, uint8_t* rleLine,
+    const size_t maxPixelDataSize) {
+    const size_t lineSize = width + getBitmapPaddingFromWidth(width);
+    size_t pixelDataSize = 0;
+
+    for (size_t i = 1; i <= height; i++) {
+        readExactly(line, lineSize, in);
+        size_t size = bmpRleBoundaryWriteLine(line, width, rleLine);
+        rleLine[size++] = END_OF_LINE_BYTE;
+        // end of file or end of line
+        rleLine[size++] = height == i ? END_OF_BITMAP_BYTE : END_OF_LINE_BYTE;
+        if (pixelDataSize + size > maxPixelDataSize) {
+            throwError("Streaming from a pipe into a pipe is limited to 64 MiB of compressed pixel data, write to a file instead");
+        }
+        writeExactly(rleLine, size, out);
+        pixelDataSize += size;
+    }
+    return pixelDataSize;
+}
+
+/*
+ * Compress the scan lines [firstLine, firstLine + lines) of a tiled bitmap into 'rleData', returns their size
+ * every tile but the last one ends with end of line, the next tile continues the bitmap
+ */
+static size_t compressTile(const struct tiledJob* job, const size_t firstLine, const size_t lines, uint8_t* rleData) {
+    const size_t* lineSizes = job->lineSizes != NULL ? job->lineSizes + firstLine : NULL;
+    const size_t size = bmpRleParallel(job->imgIn + (ptrdiff_t)firstLine * job->stride, job->width, lines, job->stride, rleData,
+        job->bmpRle, job->threadCount, lineSizes);
+    if (size == 0) throwSystemError("Error while allocating memory");
+    // offsets relative to the tile, moved to the pixel data by 'writeTiles'
+    if (job->rowOffsets != NULL) bmpRleIndexRows(rleData, size, lines, job->rowOffsets + firstLine);
+    if (firstLine + lines < job->height) {
+        // replace end of file by end of line
+        rleData[size - 1] = END_OF_LINE_BYTE;
+    }
+    return size;
+}
+
+/*
+ * Drop the pages of the mapped input of a compressed tile, so only the tile in flight stays resident
+ * the input is mapped read-only, dropped pages are read from the file again if needed
+ */
+static void releaseTileInput(const struct tiledJob* job, const size_t firstLine, const size_t lines) {
+    const uint8_t* first = job->imgIn + (ptrdiff_t)firstLine * job->stride;
+    const uint8_t* last = job->imgIn + (ptrdiff_t)(firstLine + lines - 1) * job->stride;
+    const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    // only pages completely inside of the tile
+    const uintptr_t start = ((uintptr_t)(first < last ? first : last) + pageSize - 1) & ~(pageSize - 1);
+    const uintptr_t end = ((uintptr_t)(first < last ? last : first) + job->width) & ~(pageSize - 1);
+    if (end > start) madvise((void*)start, end - start, MADV_DONTNEED);
+}
+
+/*
+ * Compress every tile into 'tile' and write it to 'out' if not NULL, returns the size of the pixel data
+ */
+static size_t writeTiles(const struct tiledJob* job, const size_t tileHeight, uint8_t* tile, FILE* out) {
+    size_t pixelDataSize = 0;
+    for (size_t firstLine = 0; firstLine < job->height; firstLine += tileHeight) {
+        const size_t lines = firstLine + tileHeight > job->height ? job->height - firstLine : tileHeight;
+        const size_t size = compressTile(job, firstLine, lines, tile);
+        releaseTileInput(job, firstLine, lines);
+        for (size_t i = firstLine; job->rowOffsets != NULL && i <= firstLine + lines; i++) {
+            job->rowOffsets[i] += pixelDataSize;
+        }
+        if (out != NULL) writeExactly(tile, size, out);
+        pixelDataSize += size;
+    }
+    return pixelDataSize;
+}
+
+/*
+ * Compress a mapped bitmap in tiles of scan lines and write the metadata 'outHeader' ('offBits' bytes) and the pixel data to 'out'
+ * every tile is compressed by 'bmpRle' on 'threadCount' threads into one buffer of at most 'TILE_OUTPUT_SIZE' bytes
+ * if the exact size of every compressed scan line is known, so is the size of the pixel data before writing
+ * returns the size of the pixel data
+ */
+size_t bmpRleTiled(const struct tiledJob* job, uint8_t* outHeader, const uint32_t offBits, FILE* out) {
+    const size_t maxLineSize = getMaxPixelDataSize(job->width, 1);
+    size_t tileHeight = TILE_OUTPUT_SIZE / maxLineSize;
+    if (tileHeight == 0) tileHeight = 1;
+    if (tileHeight > job->height) tileHeight = job->height;
+    uint8_t* tile = malloc(maxLineSize * tileHeight);
+    if (tile == NULL) throwSystemError("Error while allocating memory");
+
+    size_t pixelDataSize = 0;
+    if (job->lineSizes == NULL && isSeekable(out)) {
+        // write the header with unknown sizes and patch it afterwards
+        const long headerPosition = ftell(out);
+        writeExactly(outHeader, offBits, out);
+        pixelDataSize = writeTiles(job, tileHeight, tile, out);
+        if (!isRleSizeValid(offBits, pixelDataSize)) throwValidationError(ERROR_TOO_LARGE);
+        writeBitmapSizesForRle(outHeader, offBits, pixelDataSize);
+        if (fseek(out, headerPosition, SEEK_SET) != 0) throwSystemError("Error while writing output file");
+        writeExactly(outHeader, offBits, out);
+        if (fseek(out, 0, SEEK_END) != 0) throwSystemError("Error while writing output file");
+    }
+    else {
+        if (job->lineSizes != NULL) {
+            for (size_t i = 0; i < job->height; i++) {
+                pixelDataSize += job->lineSizes[i];
+            }
+        }
+        else {
+            // counting pass, the tiles are compressed again while writing
+            pixelDataSize = writeTiles(job, tileHeight, tile, NULL);
+        }
+        if (!isRleSizeValid(offBits, pixelDataSize)) throwValidationError(ERROR_TOO_LARGE);
+        writeBitmapSizesForRle(outHeader, offBits, pixelDataSize);
+        writeExactly(outHeader, offBits, out);
+        writeTiles(job, tileHeight, tile, out);
+    }
+
+    free(tile);
+    return pixelDataSize;
+}
+
+/*
+ * Compress the bitmap read from 'in' with RLE_8 and write it to 'out'
+ */
+void bmpRleStream(FILE* in, FILE* out) {
+    uint8_t header[MAX_INFO_OFF_BITS];
+    readHeader(header, in);
+
+    const size_t width = getWidth(header);
+    const size_t height = getHeight(header);
+    const size_t lineSize = width + getBitmapPaddingFromWidth(width);
+    uint8_t outHeader[MAX_INFO_OFF_BITS];
+    const uint32_t offBits = writeBitmapMetadataForRle(header, outHeader);
+
+    uint8_t* line = malloc(lineSize);
+    // every pixel in encoded mode (2 bytes) plus end of line
+    uint8_t* rleLine = malloc(2 * (width + 1));
+    if (line == NULL || rleLine == NULL) throwSystemError("Error while allocating memory");
+
+    if (isSeekable(out)) {
+        // write the header with unknown sizes and patch it afterwards
+        const long headerPosition = ftell(out);
+        writeExactly(outHeader, offBits, out);
+        const size_t pixelDataSize = streamLines(in, out, width, height, line, rleLine, SIZE_MAX);
+        if (!isRleSizeValid(offBits, pixelDataSize)) throwValidationError(ERROR_TOO_LARGE);
+        writeBitmapSizesForRle(outHeader, offBits, pixelDataSize);
+        if (fseek(out, headerPosition, SEEK_SET) != 0) throwSystemError("Error while writing output file");
+        writeExactly(outHeader, offBits, out);
+        if (fseek(out, 0, SEEK_END) != 0) throwSystemError("Error while writing output file");
+    }
+    else if (isSeekable(in)) {
+        // counting pass over the pixel data, then encode it again
+        const long pixelDataPosition = ftell(in);
+        size_t pixelDataSize = 0;
+        for (size_t i = 0; i < height; i++) {
+            readExactly(line, lineSize, in);
+            pixelDataSize += bmpRleBoundaryMeasureLine(line, width) + 2;
+        }
+        if (fseek(in, pixelDataPosition, SEEK_SET) != 0) throwSystemError("Error while reading input file");
+        if (!isRleSizeValid(offBits, pixelDataSize)) throwValidationError(ERROR_TOO_LARGE);
+        writeBitmapSizesForRle(outHeader, offBits, pixelDataSize);
+        writeExactly(outHeader, offBits, out);
+        streamLines(in, out, width, height, line, rleLine, SIZE_MAX);
+    }
+    else {
+        // neither stream can be repositioned, only the compressed pixel data is buffered (bounded like a tile)
+        char* pixelData = NULL;
+        size_t pixelDataSize = 0;
+        FILE* buffer = open_memstream(&pixelData, &pixelDataSize);
+        if (buffer == NULL) throwSystemError("Error while allocating memory");
+        streamLines(in, buffer, width, height, line, rleLine, TILE_OUTPUT_SIZE);
+        if (fclose(buffer) != 0) throwSystemError("Error while allocating memory");
+        if (!isRleSizeValid(offBits, pixelDataSize)) throwValidationError(ERROR_TOO_LARGE);
+        writeBitmapSizesForRle(outHeader, offBits, pixelDataSize);
+        writeExactly(outHeader, offBits, out);
+        writeExactly(pixelData, pixelDataSize, out);
+        free(pixelData);
+    }
+
+    free(line);
+    free(rleLine);
+}
@@ -0,0 +1,224 @@
+/*
+ * Autotuned version selection
+ * '--tune' measures every version on synthetic bitmaps of a few content classes and stores the fastest version
+ * of every class in a tuning profile of this host
+ * '-V auto' samples the ratio of equal neighbouring pixels of a bitmap, looks up its content class in the profile
+ * and compresses with the version that was fastest on this host
+ * Only versions using absolute and encoded mode are tuned, so 'auto' never trades compression for speed (V3)
+ * and never compression time for size (V7)
+ */
+
+#include <stdio.h> // fprintf
+#include <stdlib.h> // malloc, qsort, getenv
+#include <string.h> // strcmp
+#include <errno.h>
+#include <time.h> // clock_gettime
+#include <unistd.h> // gethostname
+#include <limits.h> // PATH_MAX, HOST_NAME_MAX
+#include <sys/stat.h> // mkdir
+#include "bitmap.h"
+#include "util.h"
+
+// size of the synthetic bitmap of every content class
+#define TUNE_WIDTH 1920
+#define TUNE_HEIGHT 1080
+#define TUNE_WARMUP_RUNS 1
+#define TUNE_RUNS 9
+// scan lines sampled to classify a bitmap
+#define SAMPLED_LINES 64
+
+static const long tunedVersions[] = { 0, 1, 2, VERSION_AVX2, VERSION_AVX512, VERSION_BOUNDARY };
+#define TUNED_VERSION_COUNT (sizeof(tunedVersions) / sizeof(tunedVersions[0]))
+
+// content classes by the ratio of equal neighbouring pixels, 'meanRunLength' of the synthetic bitmap is in the middle of the class
+static const struct {
+    const char* name;
+    double maxEqualRatio; // exclusive
+    double meanRunLength;
+} contentClasses[CONTENT_CLASS_COUNT] = {
+    { "noise", 0.30, 1.18 },
+    { "mixed", 0.65, 1.9 },
+    { "runs", 0.92, 5.0 },
+    { "flat", 1.01, 33.0 },
+};
+
+/*
+ * Ratio of pixels equal to their right neighbour in up to 'SAMPLED_LINES' evenly spaced scan lines
+ */
+double getEqualNeighbourRatio(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride) {
+    if (width < 2) return 1.0;
+    const size_t step = height > SAMPLED_LINES ? height / SAMPLED_LINES : 1;
+    size_t equal = 0;
+    size_t compared = 0;
+
+    for (size_t i = 0; i < height; i += step) {
+        const uint8_t* line = imgIn + (ptrdiff_t)i * stride;
+        for (size_t x = 0; x + 1 < width; x++) {
+            equal += line[x] == line[x + 1];
+        }
+        compared += width - 1;
+    }
+    return (double)equal / compared;
+}
+
+/*
+ * Returns the version of the content class of the bitmap in 'profile'
+ */
+long selectTunedVersion(const struct tuningProfile* profile, const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride) {
+    const double equalRatio = getEqualNeighbourRatio(imgIn, width, height, stride);
+    int contentClass = 0;
+    while (contentClass + 1 < CONTENT_CLASS_COUNT && equalRatio >= contentClasses[contentClass].maxEqualRatio) {
+        contentClass++;
+    }
+    return profile->versions[contentClass];
+}
+
+/*
+ * Path of the tuning profile of this host: $XDG_CONFIG_HOME/bmprle/<host>.profile (or ~/.config/bmprle/<host>.profile)
+ * if 'isCreatingDirectory' the directories are created
+ */
+void getDefaultProfileFile(char* profileFile, size_t size, char isCreatingDirectory) {
+    char host[HOST_NAME_MAX + 1] = "localhost";
+    gethostname(host, sizeof(host));
+    host[HOST_NAME_MAX] = '\0';
+
+    char directory[PATH_MAX];
+    const char* configHome = getenv("XDG_CONFIG_HOME");
+    const char* home = getenv("HOME");
+    if (configHome != NULL && configHome[0] != '\0') snprintf(directory, sizeof(directory), "%s/bmprle", configHome);
+    else if (home != NULL && home[0] != '\0') snprintf(directory, sizeof(directory), "%s/.config/bmprle", home);
+    else snprintf(directory, sizeof(directory), ".");
+
+    if (isCreatingDirectory) {
+        // create every missing directory of the path
+        for (char* separator = strchr(directory + 1, '/'); separator != NULL; separator = strchr(separator + 1, '/')) {
+            *separator = '\0';
+            mkdir(directory, 0755);
+            *separator = '/';
+        }
+        if (mkdir(directory, 0755) == -1 && errno != EEXIST) throwSystemError("Error while creating profile directory");
+    }
+    snprintf(profileFile, size, "%s/%s.profile", directory, host);
+}
+
+/*
+ * Read 'profileFile' into 'profile', lines are 'class <name> <version>', other lines are comments
+ * returns 0 if there is no profile or a class is missing
+ */
+uint8_t readTuningProfile(const char* profileFile, struct tuningProfile* profile) {
+    FILE* in = fopen(profileFile, "r");
+    if (in == NULL) return 0;
+
+    uint8_t foundClasses = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char name[32];
+        long version;
+        if (sscanf(line, "class %31s %ld", name, &version) != 2) continue;
+        if (version < 0 || version >= amountOfVersions || !isVersionSupported(version)) continue;
+        for (int i = 0; i < CONTENT_CLASS_COUNT; i++) {
+            if (strcmp(name, contentClasses[i].name) == 0) {
+                profile->versions[i] = version;
+                foundClasses |= 1 << i;
+            }
+        }
+    }
+    fclose(in);
+    return foundClasses == (1 << CONTENT_CLASS_COUNT) - 1;
+}
+
+static uint64_t nextRandom(uint64_t* state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/*
+ * Fill a bitmap with random runs of geometric distributed length with mean 'meanRunLength'
+ */
+static void generateContent(uint8_t* imgIn, const size_t width, const size_t height, const double meanRunLength) {
+    const size_t lineSize = width + getBitmapPaddingFromWidth(width);
+    // a pixel continues its run with probability 1 - 1 / meanRunLength
+    const uint64_t continueThreshold = (uint64_t)((1.0 - 1.0 / meanRunLength) * (double)UINT32_MAX);
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    for (size_t i = 0; i < height; i++) {
+        uint8_t* line = imgIn + i * lineSize;
+        uint8_t pixel = nextRandom(&state);
+        for (size_t x = 0; x < lineSize; x++) {
+            if (x > 0 && (nextRandom(&state) >> 32) >= continueThreshold) {
+                // a new run starts with a different pixel
+                pixel += 1 + nextRandom(&state) % 255;
+            }
+            line[x] = x < width ? pixel : 0;
+        }
+    }
+}
+
+static int compareDouble(const void* a, const void* b) {
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Median seconds of 'bmpRle' on one thread
+ */
+static double measureVersion(const uint8_t* imgIn, const size_t width, const size_t height, const ptrdiff_t stride, uint8_t* rleData,
+    bmpRleFunction bmpRle) {
+    double times[TUNE_RUNS];
+    for (int i = 0; i < TUNE_WARMUP_RUNS + TUNE_RUNS; i++) {
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bmpRle(imgIn, width, height, stride, rleData);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (i >= TUNE_WARMUP_RUNS) times[i - TUNE_WARMUP_RUNS] = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+    }
+    qsort(times, TUNE_RUNS, sizeof(double), compareDouble);
+    return times[TUNE_RUNS / 2];
+}
+
+/*
+ * Measure every supported version on every content class and write the fastest versions to 'profileFile'
+ * the throughput of every version is printed to stdout and kept as comment in the profile
+ */
+void bmpRleTune(const char* profileFile) {
+    const size_t lineSize = getBitmapLineSize(TUNE_WIDTH, BITS_PER_PIXEL);
+    uint8_t* imgIn = malloc(lineSize * TUNE_HEIGHT);
+    uint8_t* rleData = malloc(getMaxPixelDataSize(TUNE_WIDTH, TUNE_HEIGHT));
+    if (imgIn == NULL || rleData == NULL) throwSystemError("Error while allocating memory");
+
+    FILE* out = fopen(profileFile, "w");
+    if (out == NULL) throwSystemError("Error while opening profile file");
+    fprintf(out, "# bmpRle tuning profile, written by --tune\n");
+    fprintf(out, "# class <name> <fastest version>, content classes by ratio of equal neighbouring pixels\n");
+
+    for (int c = 0; c < CONTENT_CLASS_COUNT; c++) {
+        generateContent(imgIn, TUNE_WIDTH, TUNE_HEIGHT, contentClasses[c].meanRunLength);
+        printf("%s (equal neighbour ratio %.2f):", contentClasses[c].name, getEqualNeighbourRatio(imgIn, TUNE_WIDTH, TUNE_HEIGHT, lineSize));
+        fprintf(out, "# %s, equal neighbour ratio below %.2f, MB/s:", contentClasses[c].name, contentClasses[c].maxEqualRatio);
+
+        long fastestVersion = VERSION_SSE2;
+        double fastestTime = 0.0;
+        for (size_t v = 0; v < TUNED_VERSION_COUNT; v++) {
+            if (!isVersionSupported(tunedVersions[v])) continue;
+            const double time = measureVersion(imgIn, TUNE_WIDTH, TUNE_HEIGHT, lineSize, rleData, getCompressionFunction(tunedVersions[v]));
+            const double megabytesPerSecond = time > 0.0 ? TUNE_WIDTH * TUNE_HEIGHT / time / 1e6 : 0.0;
+            printf(" V%ld %.0f MB/s", tunedVersions[v], megabytesPerSecond);
+            fprintf(out, " V%ld %.0f", tunedVersions[v], megabytesPerSecond);
+            if (fastestTime == 0.0 || time < fastestTime) {
+                fastestTime = time;
+                fastestVersion = tunedVersions[v];
+            }
+        }
+        printf(" -> V%ld\n", fastestVersion);
+        fprintf(out, "\nclass %s %ld\n", contentClasses[c].name, fastestVersion);
+    }
+
+    if (fclose(out) != 0) throwSystemError("Error while writing profile file");
+    free(imgIn);
+    free(rleData);
+}
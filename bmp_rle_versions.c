@@ -0,0 +1,64 @@
+/*
+ * Registry of all compression versions and runtime CPU dispatch
+ */
+
+#include <stdint.h> // uint
+#include "bitmap.h"
+
+// every version reuses the tokens of repeated scan lines (see bmp_rle_dedup.c)
+#define DEFINE_DEDUP_VERSION(name, bmpRle) \
+    static size_t name(const uint8_t* imgIn, size_t width, size_t height, ptrdiff_t stride, uint8_t* rleData) { \
+        return bmpRleDedup(imgIn, width, height, stride, rleData, bmpRle); \
+    }
+
+DEFINE_DEDUP_VERSION(bmpRleDedupV0, bmpRle)
+DEFINE_DEDUP_VERSION(bmpRleDedupV1, bmpRleV1)
+DEFINE_DEDUP_VERSION(bmpRleDedupV2, bmpRleV2)
+DEFINE_DEDUP_VERSION(bmpRleDedupV3, bmpRleEncodeV3)
+DEFINE_DEDUP_VERSION(bmpRleDedupV4, bmpRleAvx2)
+DEFINE_DEDUP_VERSION(bmpRleDedupV5, bmpRleAvx512)
+DEFINE_DEDUP_VERSION(bmpRleDedupV6, bmpRleBoundary)
+DEFINE_DEDUP_VERSION(bmpRleDedupV7, bmpRleOptimal)
+
+static const bmpRleFunction bmpCompressionFunctionPointer[] = { bmpRleDedupV0, bmpRleDedupV1, bmpRleDedupV2, bmpRleDedupV3,
+    bmpRleDedupV4, bmpRleDedupV5, bmpRleDedupV6, bmpRleDedupV7 };
+const long amountOfVersions = sizeof(bmpCompressionFunctionPointer) / sizeof(bmpCompressionFunctionPointer[0]);
+
+/*
+ * Returns the compression function of 'versionNumber' or NULL if it does not exist
+ */
+bmpRleFunction getCompressionFunction(const long versionNumber) {
+    if (versionNumber < 0 || versionNumber >= amountOfVersions) return NULL;
+    return bmpCompressionFunctionPointer[versionNumber];
+}
+
+/*
+ * Returns the function measuring the exact output size of 'versionNumber' or NULL if the version has none
+ */
+bmpRleMeasureFunction getMeasureFunction(const long versionNumber) {
+    return versionNumber == VERSION_BOUNDARY ? bmpRleBoundaryMeasure : NULL;
+}
+
+/*
+ * Check via cpuid if the instruction set used by 'versionNumber' is available
+ */
+uint8_t isVersionSupported(const long versionNumber) {
+    __builtin_cpu_init();
+    switch (versionNumber) {
+    case VERSION_AVX2:
+        return __builtin_cpu_supports("avx2") != 0;
+    case VERSION_AVX512:
+        return __builtin_cpu_supports("avx512bw") != 0;
+    default:
+        return versionNumber >= 0 && versionNumber < amountOfVersions;
+    }
+}
+
+/*
+ * Returns the SIMD version with the widest vectors supported by this CPU
+ */
+long getWidestSupportedVersion() {
+    if (isVersionSupported(VERSION_AVX512)) return VERSION_AVX512;
+    if (isVersionSupported(VERSION_AVX2)) return VERSION_AVX2;
+    return VERSION_SSE2;
+}
@@ -0,0 +1,74 @@
+/*
+ * Embeddable interface of libbmprle
+ * An encoder context selects a version once and keeps its scratch and output buffers between calls,
+ * every function returns 'SUCCESS_BITMAP_VALIDATION' or an 'ERROR_*' code of bitmap.h instead of exiting,
+ * 'getValidationErrorMessage' describes a code
+ */
+
+#ifndef TEAM121_BMPRLE_H
+#define TEAM121_BMPRLE_H
+
+#include <stdint.h> // uint
+#include <stddef.h> // size_t
+#include "bitmap.h"
+
+typedef struct bmpRleContext bmpRleContext;
+
+// scan lines [first, first + count), counted from the bottom like the scan lines of the RLE_8 data
+struct bmpRleRowRange {
+    size_t first;
+    size_t count;
+};
+
+/*
+ * Create a context compressing with 'versionNumber' (or -1 for the widest SIMD version) on 'threadCount' threads
+ */
+uint8_t bmpRleCreateContext(bmpRleContext** context, long versionNumber, size_t threadCount);
+void bmpRleDestroyContext(bmpRleContext* context);
+
+/*
+ * Grow the buffers of 'context' for 8bpp bitmaps of up to 'width' x 'height' pixels and fault in their pages,
+ * so later calls up to this size neither allocate nor touch fresh memory
+ */
+uint8_t bmpRleReserveContext(bmpRleContext* context, size_t width, size_t height);
+
+/*
+ * Compress 'height' scan lines of 'width' 8bpp pixels, scan line i starts at 'pixels' + i * 'stride' (bottom-up)
+ * '*rleData' points to the RLE_8 pixel data owned by the context, valid until the next call
+ */
+uint8_t bmpRleEncodePixels(bmpRleContext* context, const uint8_t* pixels, size_t width, size_t height, size_t stride,
+    const uint8_t** rleData, size_t* rleSize);
+
+/*
+ * Compress the update of the frame 'pixels' over the previous frame 'reference' of a sequence, both with the layout of 'pixels'
+ * only the pixels that differ from the reference are encoded, the others are skipped with delta escapes (always on one thread)
+ */
+uint8_t bmpRleEncodeFrame(bmpRleContext* context, const uint8_t* pixels, const uint8_t* reference, size_t width, size_t height, size_t stride,
+    const uint8_t** rleData, size_t* rleSize);
+
+/*
+ * Compress the 8bpp or 4bpp bitmap file 'bitmap' of 'size' bytes, the header is parsed once into 'header' (may be NULL)
+ * 24bpp and 32bpp bitmaps are quantised to the 3-3-2 palette first, top-down bitmaps are written bottom-up
+ * '*outputBitmap' points to the compressed bitmap file owned by the context, valid until the next call
+ */
+uint8_t bmpRleEncodeBitmap(bmpRleContext* context, const uint8_t* bitmap, size_t size, struct bitmapHeader* header,
+    const uint8_t** outputBitmap, size_t* outputSize);
+
+/*
+ * Re-encode the dirty scan lines 'ranges' (sorted, not overlapping) of 'pixels' and splice them into the RLE_8 pixel data 'rleData'
+ * of '*rleSize' bytes in a buffer of 'capacity' bytes, the pixel data behind every range is moved once
+ * 'rowOffsets' (height + 1 entries, see bmpRleIndexRows) locates the scan lines and is kept up to date
+ * if the updated pixel data doesn't fit into 'capacity' nothing is changed, '*rleSize' plus
+ * getMaxPixelDataSize(width, count) of every range always fits
+ */
+uint8_t bmpRleUpdatePixels(bmpRleContext* context, const uint8_t* pixels, size_t width, size_t height, size_t stride,
+    const struct bmpRleRowRange* ranges, size_t rangeCount, uint8_t* rleData, size_t* rleSize, size_t capacity, size_t* rowOffsets);
+
+/*
+ * bmpRleUpdatePixels for the pixel data of the compressed 8bpp bitmap file 'bitmap' of '*size' bytes,
+ * width and height are read from its header, the sizes in the header and '*size' are updated
+ */
+uint8_t bmpRleUpdateBitmap(bmpRleContext* context, const uint8_t* pixels, size_t stride, const struct bmpRleRowRange* ranges, size_t rangeCount,
+    uint8_t* bitmap, size_t* size, size_t capacity, size_t* rowOffsets);
+
+#endif //TEAM121_BMPRLE_H
@@ -1,38 +1,436 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
-#include <time.h>
+#include <fcntl.h> // open
+#include <unistd.h> // close, ftruncate
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <sys/uio.h> // writev
+#include <limits.h> // PATH_MAX
 #include "bitmap.h"
+#include "bmprle.h"
 #include "util.h"
 
-size_t(*bmpCompressionFunctionPointer[])(const uint8_t*, size_t, size_t, uint8_t*) = { bmpRle, bmpRleV1, bmpRleV2, bmpRleEncodeV3 };
-int amountOfVersions = 4;
-
 static struct option long_options[] = {
     {"help", no_argument, NULL, 'h'},
+    {"warmup", required_argument, NULL, 'w'},
+    {"cpu", required_argument, NULL, 'c'},
+    {"cold", no_argument, NULL, 'C'},
+    {"json", no_argument, NULL, 'j'},
+    {"counters", no_argument, NULL, 'k'},
+    {"tune", no_argument, NULL, 't'},
+    {"profile", required_argument, NULL, 'p'},
+    {"update", required_argument, NULL, 'u'},
+    {"rows", required_argument, NULL, 'r'},
+    {"index", required_argument, NULL, 'i'},
+    {"daemon", required_argument, NULL, 'L'},
+    {"connect", required_argument, NULL, 'N'},
     {0, 0, 0, 0}  // for array termination
 };
 
+/*
+ * Decompress the RLE_8 bitmap 'inputBuffer' and write it to 'ptrOut'
+ * if 'reference' is not NULL the bitmap is an update of the reference frame (see -R) and is played back over its pixels
+ */
+static void decompressBitmap(uint8_t* inputBuffer, const long inputSize, const uint8_t* reference, const struct bitmapHeader* referenceHeader,
+    FILE* ptrOut) {
+    const uint8_t code = validateRleBitmap(inputBuffer, inputSize);
+    if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+    if (reference != NULL && getBitCount(inputBuffer) != BITS_PER_PIXEL) throwError("Reference frame(-R) is only supported for 8bpp bitmaps");
+    if (reference != NULL && (referenceHeader->width != getWidth(inputBuffer) || referenceHeader->height != getHeight(inputBuffer))) {
+        throwError("The reference frame(-R) must have the size of the bitmap");
+    }
+
+    uint8_t* outputBuffer = createOutputBufferForDecode(inputBuffer);
+    if (outputBuffer == NULL) throwSystemError("Error while allocating memory");
+
+    const uint32_t size = writeBitmapMetadataForDecode(inputBuffer, outputBuffer);
+    if (reference != NULL) {
+        // pixels skipped by the update keep the pixels of the reference frame
+        const size_t lineSize = getBitmapLineSize(referenceHeader->width, BITS_PER_PIXEL);
+        const ptrdiff_t referenceStride = getBitmapStride(referenceHeader);
+        uint8_t* outPixelPointer = moveToPixelData(outputBuffer);
+        for (size_t i = 0; i < (size_t)referenceHeader->height; i++) {
+            memcpy(outPixelPointer + i * lineSize, reference + (ptrdiff_t)i * referenceStride, referenceHeader->width);
+        }
+    }
+    uint8_t(*decode)(const uint8_t*, size_t, size_t, size_t, uint8_t*) = getBitCount(inputBuffer) == BITS_PER_PIXEL_RLE4 ? bmpRle4Decode : bmpRleDecode;
+    const uint8_t decodeCode = decode(moveToPixelData(inputBuffer), inputSize - getOffBits(inputBuffer),
+        getWidth(inputBuffer), getHeight(inputBuffer), moveToPixelData(outputBuffer));
+    if (decodeCode != SUCCESS_BITMAP_VALIDATION) throwValidationError(decodeCode);
+
+    // write decompressed output
+    fwrite(outputBuffer, size, 1, ptrOut);
+    free(outputBuffer);
+}
+
+/*
+ * Map 'inputFile' read-only, the size of the file is stored in 'inputSize'
+ */
+static uint8_t* mapInputFile(const char* inputFile, long* inputSize) {
+    const int fd = open(inputFile, O_RDONLY);
+    if (fd == -1) throwSystemError("Error while opening input file");
+
+    struct stat inputStat;
+    if (fstat(fd, &inputStat) == -1) throwSystemError("Can't read size of input file");
+    // an empty file can't be mapped
+    if (inputStat.st_size < MIN_BITMAP_SIZE) throwValidationError(ERROR_TOO_SMALL);
+
+    uint8_t* inputBuffer = mmap(NULL, inputStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (inputBuffer == MAP_FAILED) throwSystemError("Error while mapping input file");
+    // the mapping stays valid after closing
+    close(fd);
+
+    *inputSize = inputStat.st_size;
+    return inputBuffer;
+}
+
+/*
+ * Map the reference frame 'referenceFile' (see -R), an uncompressed 8bpp bitmap, its header is parsed into 'header'
+ * returns its bottom scan line, the mapping and its size are stored in 'referenceBuffer' and 'referenceSize'
+ */
+static const uint8_t* mapReferenceFrame(const char* referenceFile, struct bitmapHeader* header, uint8_t** referenceBuffer, long* referenceSize) {
+    *referenceBuffer = mapInputFile(referenceFile, referenceSize);
+    const uint8_t code = parseBitmap(*referenceBuffer, *referenceSize, header);
+    if (code != SUCCESS_BITMAP_VALIDATION && code != ERROR_BITS_PER_PIXEL) throwValidationError(code);
+    if (code == ERROR_BITS_PER_PIXEL || header->bitCount != BITS_PER_PIXEL) throwError("Reference frame(-R) is only supported for 8bpp bitmaps");
+    return getBottomLine(*referenceBuffer, header);
+}
+
+/*
+ * Write the row index of the 'height' scan line offsets 'rowOffsets' to 'indexFile' (see --index)
+ */
+static void writeRowIndexFile(const char* indexFile, const size_t* rowOffsets, const size_t height) {
+    const size_t indexSize = getRowIndexSize(height);
+    uint8_t* index = malloc(indexSize);
+    if (index == NULL) throwSystemError("Error while allocating memory");
+    writeRowIndex(rowOffsets, height, index);
+
+    FILE* ptrIndex = fopen(indexFile, "w");
+    if (ptrIndex == NULL) throwSystemError("Error while opening index file");
+    if (fwrite(index, indexSize, 1, ptrIndex) != 1) throwSystemError("Error while writing index file");
+    fclose(ptrIndex);
+    free(index);
+}
+
+/*
+ * Read the row index 'indexFile' (see --index) of pixel data of 'height' scan lines and 'rleSize' bytes into 'rowOffsets'
+ */
+static void readRowIndexFile(const char* indexFile, const size_t height, const size_t rleSize, size_t* rowOffsets) {
+    FILE* ptrIndex = fopen(indexFile, "r");
+    if (ptrIndex == NULL) throwSystemError("Error while opening index file");
+    // a larger file doesn't belong to the bitmap, one byte more than expected is enough to tell
+    const size_t indexSize = getRowIndexSize(height);
+    uint8_t* index = malloc(indexSize + 1);
+    if (index == NULL) throwSystemError("Error while allocating memory");
+    const size_t readSize = fread(index, 1, indexSize + 1, ptrIndex);
+    if (ferror(ptrIndex)) throwSystemError("Error while reading index file");
+    fclose(ptrIndex);
+
+    const uint8_t code = readRowIndex(index, readSize, height, rleSize, rowOffsets);
+    if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+    free(index);
+}
+
+static int compareRowRanges(const void* a, const void* b) {
+    const struct bmpRleRowRange* rangeA = a;
+    const struct bmpRleRowRange* rangeB = b;
+    return rangeA->first < rangeB->first ? -1 : rangeA->first > rangeB->first;
+}
+
+/*
+ * Parse the dirty scan lines 'rows' ("y0-y1,y2,...", inclusive and counted from the top of the image, see --rows)
+ * into ranges counted from the bottom, sorted and merged, returns the number of ranges
+ */
+static size_t parseRowRanges(char* rows, const size_t height, struct bmpRleRowRange** ranges) {
+    size_t rangeCount = 0;
+    *ranges = NULL;
+    char* savePointer;
+    for (char* token = strtok_r(rows, ",", &savePointer); token != NULL; token = strtok_r(NULL, ",", &savePointer)) {
+        char* separator = strchr(token, '-');
+        if (separator != NULL) *separator = '\0';
+        const long top = getNumberAsLong(token);
+        const long bottom = separator != NULL ? getNumberAsLong(separator + 1) : top;
+        if (top < 0 || bottom < top || (size_t)bottom >= height) throwError("Rows(--rows) should be scan lines y0-y1 of the bitmap, separated by ','");
+
+        *ranges = realloc(*ranges, sizeof(struct bmpRleRowRange) * (rangeCount + 1));
+        if (*ranges == NULL) throwSystemError("Error while allocating memory");
+        (*ranges)[rangeCount].first = height - 1 - bottom;
+        (*ranges)[rangeCount].count = bottom - top + 1;
+        rangeCount++;
+    }
+    if (rangeCount == 0) throwError("Rows(--rows) should be scan lines y0-y1 of the bitmap, separated by ','");
+
+    qsort(*ranges, rangeCount, sizeof(struct bmpRleRowRange), compareRowRanges);
+    size_t merged = 0;
+    for (size_t i = 1; i < rangeCount; i++) {
+        struct bmpRleRowRange* last = &(*ranges)[merged];
+        if ((*ranges)[i].first <= last->first + last->count) {
+            const size_t end = (*ranges)[i].first + (*ranges)[i].count;
+            if (end > last->first + last->count) last->count = end - last->first;
+        }
+        else {
+            (*ranges)[++merged] = (*ranges)[i];
+        }
+    }
+    return merged + 1;
+}
+
+/*
+ * Decompress the scan lines 'rows' (one range y0-y1 counted from the top, all if NULL) of the RLE_8 bitmap 'inputBuffer'
+ * on 'threadCount' threads and write them to 'ptrOut' as a bitmap of their own
+ * the scan lines are located by the row index 'indexFile' (see --index) or by walking the tokens once
+ * bitmaps that can't be indexed (RLE_4, delta escapes) are decoded from the start if neither rows nor an index are given
+ */
+static void decompressRows(uint8_t* inputBuffer, const long inputSize, const char* indexFile, char* rows, const size_t threadCount, FILE* ptrOut) {
+    uint8_t code = validateRleBitmap(inputBuffer, inputSize);
+    if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+    const uint8_t isIndexable = getBitCount(inputBuffer) == BITS_PER_PIXEL;
+    if (!isIndexable && (indexFile != NULL || rows != NULL)) throwError("Index(--index) and rows(--rows) are only supported for RLE_8 bitmaps");
+
+    const size_t width = getWidth(inputBuffer);
+    const size_t height = getHeight(inputBuffer);
+    const uint8_t* rleData = moveToPixelData(inputBuffer);
+    const size_t rleSize = inputSize - getOffBits(inputBuffer);
+    size_t* rowOffsets = malloc(sizeof(size_t) * (height + 1));
+    if (rowOffsets == NULL) throwSystemError("Error while allocating memory");
+    if (indexFile != NULL) readRowIndexFile(indexFile, height, rleSize, rowOffsets);
+    else code = isIndexable ? bmpRleIndexRows(rleData, rleSize, height, rowOffsets) : ERROR_NOT_INDEXABLE;
+    if (code != SUCCESS_BITMAP_VALIDATION) {
+        if (rows != NULL) throwValidationError(code);
+        // only the threads are given, the bitmap is decoded from the start on one thread
+        free(rowOffsets);
+        decompressBitmap(inputBuffer, inputSize, NULL, NULL, ptrOut);
+        return;
+    }
+
+    size_t firstRow = 0;
+    size_t rowCount = height;
+    if (rows != NULL) {
+        struct bmpRleRowRange* ranges;
+        if (parseRowRanges(rows, height, &ranges) != 1) throwError("Rows(--rows) of -d should be a single range y0-y1");
+        firstRow = ranges[0].first;
+        rowCount = ranges[0].count;
+        free(ranges);
+    }
+
+    // the band is written as a bitmap of 'rowCount' scan lines
+    const uint32_t offBits = getOffBits(inputBuffer);
+    const size_t lineSize = getBitmapLineSize(width, BITS_PER_PIXEL);
+    uint8_t* outputBuffer = calloc(offBits + lineSize * rowCount, 1);
+    if (outputBuffer == NULL) throwSystemError("Error while allocating memory");
+    writeBitmapMetadataForDecode(inputBuffer, outputBuffer);
+    const int32_t bandHeight = rowCount;
+    memcpy(outputBuffer + BITMAP_INDEX_HEIGHT, &bandHeight, 4);
+    const uint32_t size = writeBitmapSizesForRle(outputBuffer, offBits, lineSize * rowCount);
+
+    code = bmpRleDecodeRows(rleData, rowOffsets, width, firstRow, rowCount, outputBuffer + offBits, threadCount);
+    if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+
+    // write decompressed output
+    fwrite(outputBuffer, size, 1, ptrOut);
+    free(outputBuffer);
+    free(rowOffsets);
+}
+
+/*
+ * Re-encode the dirty scan lines 'rows' of the 8bpp bitmap 'pixels' in the compressed bitmap 'updateFile' (see --update) in place
+ * the file grows by the worst case of the dirty scan lines during the update and is cut to its new size afterwards
+ * the row index 'indexFile' (may be NULL, see --index) replaces the walk over the tokens and is updated as well
+ */
+static void updateCompressedBitmap(const char* updateFile, const char* indexFile, char* rows, const uint8_t* pixels, const size_t width,
+    const size_t height, const size_t stride, const long versionNumber, const long threadCount) {
+    struct bmpRleRowRange* ranges;
+    const size_t rangeCount = parseRowRanges(rows, height, &ranges);
+
+    // the scan lines of the compressed bitmap are located by its row index or by walking its tokens once
+    long size;
+    uint8_t* bitmap = mapInputFile(updateFile, &size);
+    uint8_t code = validateRleBitmap(bitmap, size);
+    if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+    if (getBitCount(bitmap) != BITS_PER_PIXEL) throwError("Update(--update) is only supported for RLE_8 bitmaps");
+    if ((size_t)getWidth(bitmap) != width || (size_t)getHeight(bitmap) != height) throwError("The updated bitmap(--update) must have the size of the bitmap");
+    size_t* rowOffsets = malloc(sizeof(size_t) * (height + 1));
+    if (rowOffsets == NULL) throwSystemError("Error while allocating memory");
+    if (indexFile != NULL) readRowIndexFile(indexFile, height, size - getOffBits(bitmap), rowOffsets);
+    else code = bmpRleIndexRows(bitmap + getOffBits(bitmap), size - getOffBits(bitmap), height, rowOffsets);
+    if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+    munmap(bitmap, size);
+
+    size_t capacity = size;
+    for (size_t i = 0; i < rangeCount; i++) {
+        capacity += getMaxPixelDataSize(width, ranges[i].count);
+    }
+    const int fd = open(updateFile, O_RDWR);
+    if (fd == -1) throwSystemError("Error while opening updated file");
+    if (ftruncate(fd, capacity) == -1) throwSystemError("Error while resizing updated file");
+    bitmap = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (bitmap == MAP_FAILED) throwSystemError("Error while mapping updated file");
+
+    bmpRleContext* context;
+    size_t updatedSize = size;
+    code = bmpRleCreateContext(&context, versionNumber, threadCount);
+    if (code == SUCCESS_BITMAP_VALIDATION) code = bmpRleUpdateBitmap(context, pixels, stride, ranges, rangeCount, bitmap, &updatedSize, capacity, rowOffsets);
+    munmap(bitmap, capacity);
+    // a failed update leaves the bitmap unchanged
+    if (ftruncate(fd, updatedSize) == -1) throwSystemError("Error while resizing updated file");
+    close(fd);
+    if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+    if (indexFile != NULL) writeRowIndexFile(indexFile, rowOffsets, height);
+
+    bmpRleDestroyContext(context);
+    free(rowOffsets);
+    free(ranges);
+}
+
+/*
+ * Resize the regular file 'ptrOut' to 'size' bytes and map it writable
+ * returns NULL if the output can't be mapped (stdout, pipes, devices)
+ */
+static uint8_t* mapOutputFile(FILE* ptrOut, const size_t size) {
+    if (ptrOut == stdout) return NULL;
+    const int fd = fileno(ptrOut);
+    struct stat outputStat;
+    if (fstat(fd, &outputStat) == -1 || !S_ISREG(outputStat.st_mode)) return NULL;
+    if (ftruncate(fd, size) == -1) return NULL;
+
+    uint8_t* outputBuffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return outputBuffer == MAP_FAILED ? NULL : outputBuffer;
+}
+
+/*
+ * Write the compressed bitmap with a single writev: the headers, the color palette straight from the
+ * mapped 'inputBuffer' (unless a BitmapCoreHeader needs conversion, the bitmap was quantised or the palette is reordered
+ * for the background 'background' of -D, -1 otherwise) and the compressed pixel data
+ */
+static void writeCompressedBitmap(const uint8_t* inputBuffer, const uint8_t* pixelData, const size_t rleSize, const uint8_t isQuantised,
+    const int background, FILE* ptrOut) {
+    uint8_t header[MAX_INFO_OFF_BITS];
+    uint32_t headerSize;
+    if (isQuantised) headerSize = writeBitmapMetadataForQuantisedRle(inputBuffer, header);
+    else if (background != -1) headerSize = writeBitmapMetadataForDeltaRle(inputBuffer, header, background);
+    else if (isBitmapCoreHeader(inputBuffer)) headerSize = writeBitmapMetadataForRle(inputBuffer, header);
+    else headerSize = writeBitmapHeaderForRle(inputBuffer, header);
+    const uint32_t offBits = isQuantised ? QUANTISED_OFF_BITS : background != -1 ? headerSize : calcOffBitsForRle(inputBuffer);
+    writeBitmapSizesForRle(header, offBits, rleSize);
+
+    struct iovec parts[3] = {
+        { header, headerSize },
+        { (void*)(inputBuffer + headerSize), offBits - headerSize },
+        { (void*)pixelData, rleSize },
+    };
+    struct iovec* part = parts;
+    int partCount = 3;
+    while (partCount > 0) {
+        ssize_t written = writev(fileno(ptrOut), part, partCount);
+        if (written == -1) throwSystemError("Error while writing output file");
+        // continue a partial write at the first byte not written
+        for (; partCount > 0 && (size_t)written >= part->iov_len; part++, partCount--) {
+            written -= part->iov_len;
+        }
+        if (partCount > 0) {
+            part->iov_base = (uint8_t*)part->iov_base + written;
+            part->iov_len -= written;
+        }
+    }
+}
+
 int main(int argc, char** argv) {
     long versionNumber = 0; // -V <argument>
+    char isAuto = 0; // true if -V auto
+    char isTune = 0; // true if --tune option set
+    char* profileFile = NULL; // --profile <argument>
     char isBenchmark = 0; // true if -B option set
     long repetitions = 0; // -B <argument>
+    struct benchmarkOptions benchmarkOptions = { 0, 1, -1, 0, 0, 0 }; // --warmup, --cpu, --cold, --json and --counters
+    long threadCount = 1; // -T <argument>
     char* outputFile = "out.bmp"; // -o <argument>
+    char isDecompress = 0; // true if -d option set
+    char isDelta = 0; // true if -D option set
+    char* referenceFile = NULL; // -R <argument>
+    char* updateFile = NULL; // --update <argument>
+    char* rows = NULL; // --rows <argument>
+    char* indexFile = NULL; // --index <argument>
+    char* daemonSocket = NULL; // --daemon <argument>
+    char* connectSocket = NULL; // --connect <argument>
+    char* outputDirectory = NULL; // -O <argument>
+    char* manifestFile = NULL; // -M <argument>
     char opt = -1;
     do {
         int option_index = 0;
-        opt = getopt_long(argc, argv, "V:B:o:h", long_options, &option_index);
+        opt = getopt_long(argc, argv, "V:B:T:o:O:M:R:dDh", long_options, &option_index);
         switch (opt) {
         case 'V':
-            versionNumber = getNumberAsLong(optarg);
+            // 'auto' selects the tuned version of the content class of the bitmap (see --tune),
+            // without tuning profile the widest SIMD version supported by this CPU, 'optimal' the size-optimal version
+            isAuto = strcmp(optarg, "auto") == 0;
+            if (isAuto) versionNumber = getWidestSupportedVersion();
+            else if (strcmp(optarg, "optimal") == 0) versionNumber = VERSION_OPTIMAL;
+            else versionNumber = getNumberAsLong(optarg);
             break;
         case 'B':
             isBenchmark = 1;
             repetitions = getNumberAsLong(optarg);
             break;
+        case 'w':
+            benchmarkOptions.warmupRuns = getNumberAsLong(optarg);
+            break;
+        case 'c':
+            benchmarkOptions.cpu = getNumberAsLong(optarg);
+            if (benchmarkOptions.cpu < 0) throwError("CPU(--cpu) argument should be at least 0");
+            break;
+        case 'C':
+            benchmarkOptions.isCold = 1;
+            break;
+        case 'j':
+            benchmarkOptions.isJson = 1;
+            break;
+        case 'k':
+            benchmarkOptions.isCounting = 1;
+            break;
+        case 't':
+            isTune = 1;
+            break;
+        case 'p':
+            profileFile = optarg;
+            break;
+        case 'u':
+            updateFile = optarg;
+            break;
+        case 'r':
+            rows = optarg;
+            break;
+        case 'i':
+            indexFile = optarg;
+            break;
+        case 'L':
+            daemonSocket = optarg;
+            break;
+        case 'N':
+            connectSocket = optarg;
+            break;
+        case 'T':
+            threadCount = getNumberAsLong(optarg);
+            break;
         case 'o':
             outputFile = optarg;
             break;
+        case 'O':
+            outputDirectory = optarg;
+            break;
+        case 'M':
+            manifestFile = optarg;
+            break;
+        case 'R':
+            referenceFile = optarg;
+            break;
+        case 'd':
+            isDecompress = 1;
+            break;
+        case 'D':
+            isDelta = 1;
+            break;
         case 'h':
             printUsage();
             exit(0);
@@ -48,87 +446,266 @@ int main(int argc, char** argv) {
         return 0;
     }
     if (versionNumber < 0 || versionNumber >= amountOfVersions) throwError("Wrong version number");
+    if (!isVersionSupported(versionNumber)) throwError("The selected version is not supported by this CPU");
     if (repetitions < 0) throwError("Benchmark(-B) argument should be at least 0");
+    if (benchmarkOptions.warmupRuns < 0) throwError("Warmup(--warmup) argument should be at least 0");
+    if (threadCount < 1) throwError("Threads(-T) argument should be at least 1");
+    if (isDecompress && isBenchmark) throwError("Benchmark(-B) is only supported for compression");
+    if (isDecompress && isDelta) throwError("Delta(-D) is only supported for compression");
+    if (referenceFile != NULL && (isDelta || isBenchmark)) throwError("Reference frame(-R) can't be combined with -D or -B");
+    if (updateFile == NULL && rows != NULL && !isDecompress) throwError("Rows(--rows) are only supported for -d and --update");
+    if (updateFile != NULL && rows == NULL) throwError("Update(--update) requires the dirty rows(--rows)");
+    if (indexFile != NULL && (isBenchmark || isDelta || referenceFile != NULL)) throwError("Index(--index) can't be combined with -B, -D or -R");
+    if (isDecompress && referenceFile != NULL && rows != NULL) throwError("Rows(--rows) can't be combined with -R");
+    if (updateFile != NULL && (isDecompress || isBenchmark || isDelta || referenceFile != NULL)) {
+        throwError("Update(--update) can't be combined with -d, -B, -D or -R");
+    }
+
+    const uint8_t isOtherMode = isDecompress || isDelta || referenceFile != NULL || updateFile != NULL || indexFile != NULL || outputDirectory != NULL;
+    if (daemonSocket != NULL) {
+        // the daemon serves bitmaps of its clients until it is stopped, -T sets its workers
+        if (isOtherMode || isBenchmark || isTune || isAuto || connectSocket != NULL || optind < argc) {
+            throwError("Daemon(--daemon) only takes the version(-V) and the workers(-T)");
+        }
+        bmpRleDaemon(daemonSocket, versionNumber, threadCount);
+        return 0;
+    }
+    if (connectSocket != NULL && (isOtherMode || isTune || isAuto)) throwError("Connect(--connect) only takes -B, -o and one input file");
+
+    char defaultProfileFile[PATH_MAX];
+    if (profileFile == NULL && (isTune || isAuto)) {
+        getDefaultProfileFile(defaultProfileFile, sizeof(defaultProfileFile), isTune);
+        profileFile = defaultProfileFile;
+    }
+    if (isTune) {
+        bmpRleTune(profileFile);
+        printf("Tuning profile written to %s\n", profileFile);
+        return 0;
+    }
+    // without tuning profile 'auto' stays at the widest SIMD version
+    struct tuningProfile tuningProfile;
+    const struct tuningProfile* profile = isAuto && readTuningProfile(profileFile, &tuningProfile) ? &tuningProfile : NULL;
+
+    if (manifestFile != NULL && outputDirectory == NULL) throwError("Manifest(-M) requires an output directory(-O)");
+    if (outputDirectory != NULL) {
+        // batch mode, every input and every path of the manifest is compressed into the output directory
+        if (isDecompress || isBenchmark || referenceFile != NULL || updateFile != NULL || indexFile != NULL) {
+            throwError("Batch mode(-O) is only supported for compression without -B, -R, --update and --index");
+        }
+        size_t fileCount = argc - optind;
+        char** inputFiles = malloc(sizeof(char*) * (fileCount + 1));
+        if (inputFiles == NULL) throwSystemError("Error while allocating memory");
+        for (size_t i = 0; i < fileCount; i++) {
+            inputFiles[i] = strdup(argv[optind + i]);
+            if (inputFiles[i] == NULL) throwSystemError("Error while allocating memory");
+        }
+        if (manifestFile != NULL) inputFiles = readManifest(manifestFile, inputFiles, &fileCount);
+        if (fileCount == 0) throwError("No input file found");
+
+        const size_t failures = bmpRleBatch(inputFiles, fileCount, outputDirectory, versionNumber, profile, isDelta, threadCount);
+        printf("%zu of %zu bitmaps succesfully written\n", fileCount - failures, fileCount);
+        for (size_t i = 0; i < fileCount; i++) {
+            free(inputFiles[i]);
+        }
+        free(inputFiles);
+        return failures == 0 ? 0 : 1;
+    }
+
     if (optind >= argc) throwError("No input file found");
     if (argc > optind + 1) throwError("Too many input files");
 
     char* inputFile = argv[optind];
 
-    FILE* ptrIn = fopen(inputFile, "rb"); // input
-    FILE* ptrOut = fopen(outputFile, "w"); // output
+    if (connectSocket != NULL) {
+        // the version is chosen by the daemon, -B n sends the bitmap n + 1 times and reports the latency
+        if (strcmp(inputFile, "-") == 0) throwError("Reading from stdin(-) is not supported with --connect");
+        bmpRleConnect(connectSocket, inputFile, outputFile, isBenchmark ? repetitions + 1 : 1);
+        if (strcmp(outputFile, "-") != 0) printf("%s", "Bitmap succesfully written\n");
+        return 0;
+    }
 
-    if (ptrIn == NULL) throwSystemError("Error while opening input file");
-    if (ptrOut == NULL) throwSystemError("Error while opening output file");
+    if (updateFile != NULL) {
+        // the compressed bitmap is updated in place, no output file is written
+        if (strcmp(inputFile, "-") == 0) throwError("Reading from stdin(-) is only supported for compression without -B, -D, -R and --update");
+        long inputSize;
+        uint8_t* inputBuffer = mapInputFile(inputFile, &inputSize);
+        struct bitmapHeader header;
+        const uint8_t code = parseBitmap(inputBuffer, inputSize, &header);
+        if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+        if (header.bitCount != BITS_PER_PIXEL) throwError("Update(--update) is only supported for 8bpp bitmaps");
+        if (header.isTopDown) throwError("Update(--update) is not supported for top down bitmaps");
 
-    // get size of input file
-    fseek(ptrIn, 0, SEEK_END);
-    long inputSize = ftell(ptrIn);
-    rewind(ptrIn);
+        updateCompressedBitmap(updateFile, indexFile, rows, getBottomLine(inputBuffer, &header), header.width, header.height, getBitmapStride(&header),
+            versionNumber, threadCount);
+        printf("%s", "Bitmap succesfully updated\n");
+        munmap(inputBuffer, inputSize);
+        return 0;
+    }
 
-    if (inputSize == -1) throwSystemError("Can't read size of input file");
+    // '-' reads the input from stdin or writes the output to stdout
+    // opened for reading as well, so it can be mapped
+    FILE* ptrOut = strcmp(outputFile, "-") == 0 ? stdout : fopen(outputFile, "w+"); // output
+    if (ptrOut == NULL) throwSystemError("Error while opening output file");
 
-    // allocate input buffer
-    uint8_t* inputBuffer = malloc(sizeof(char) * inputSize);
-    if (inputBuffer == NULL) throwSystemError("Error while allocating memory");
+    if (strcmp(inputFile, "-") == 0) {
+        // stdin may be a pipe, so it is compressed scan line by scan line with V6
+        if (isDecompress || isBenchmark || isDelta || referenceFile != NULL || updateFile != NULL || indexFile != NULL) {
+            throwError("Reading from stdin(-) is only supported for compression without -B, -D, -R, --update and --index");
+        }
+        bmpRleStream(stdin, ptrOut);
+        if (ptrOut != stdout) printf("%s", "Bitmap succesfully written\n");
+        fclose(ptrOut);
+        return 0;
+    }
 
-    size_t read = fread(inputBuffer, 1, inputSize, ptrIn);
-    if (read != inputSize) throwError("Read failed");
+    // the input is only read, so it is mapped instead of copied into a buffer
+    long inputSize;
+    uint8_t* inputBuffer = mapInputFile(inputFile, &inputSize);
+    // the previous frame of a sequence, only the pixels that differ from it are compressed
+    struct bitmapHeader referenceHeader;
+    uint8_t* referenceBuffer = NULL;
+    long referenceSize = 0;
+    const uint8_t* reference = referenceFile != NULL ? mapReferenceFrame(referenceFile, &referenceHeader, &referenceBuffer, &referenceSize) : NULL;
 
-    // close ptrIn as input is read into 'inputBuffer'
-    fclose(ptrIn);
+    if (isDecompress) {
+        // a range of scan lines or bands on several threads need the offsets of the scan lines
+        if (reference == NULL && (indexFile != NULL || rows != NULL || threadCount > 1)) {
+            decompressRows(inputBuffer, inputSize, indexFile, rows, threadCount, ptrOut);
+        }
+        else decompressBitmap(inputBuffer, inputSize, reference, &referenceHeader, ptrOut);
+        if (ptrOut != stdout) printf("%s", "Bitmap succesfully written\n");
+        fclose(ptrOut);
+        munmap(inputBuffer, inputSize);
+        if (referenceBuffer != NULL) munmap(referenceBuffer, referenceSize);
+        return 0;
+    }
 
-    // validate if input is bitmap
-    const uint8_t code = validateBitmap(inputBuffer, inputSize);
+    // validate if input is bitmap and parse its header once
+    struct bitmapHeader header;
+    uint8_t code = parseBitmap(inputBuffer, inputSize, &header);
+    // 24bpp and 32bpp bitmaps are quantised to 8bpp scan line by scan line in front of V6
+    if (code == ERROR_BITS_PER_PIXEL) code = parseTrueColorBitmap(inputBuffer, inputSize, &header);
     if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
 
-    // get output buffer to write bitmap into
-    uint8_t* outputBuffer = createOutputBufferForRle(inputBuffer);
-    if (outputBuffer == NULL) {
-        throwSystemError("Error while allocating memory");
+    const size_t width = header.width;
+    const size_t height = header.height;
+    // top-down bitmaps are compressed from their last scan line upwards, RLE_8 and RLE_4 are always bottom-up
+    const uint8_t* inPixelPointer = getBottomLine(inputBuffer, &header);
+    const ptrdiff_t stride = getBitmapStride(&header);
+    // 4bpp bitmaps are compressed with RLE_4 on one thread, independent of the selected version
+    const uint8_t isRle4 = header.bitCount == BITS_PER_PIXEL_RLE4;
+    const uint8_t isQuantised = header.bitCount == BITS_PER_PIXEL_24 || header.bitCount == BITS_PER_PIXEL_32;
+    if ((isRle4 || isQuantised) && isDelta) throwError("Delta(-D) is only supported for 8bpp bitmaps");
+    if ((isRle4 || isQuantised) && reference != NULL) throwError("Reference frame(-R) is only supported for 8bpp bitmaps");
+    if (isRle4 && indexFile != NULL) throwError("Index(--index) is only supported for RLE_8 bitmaps");
+    if (reference != NULL && ((size_t)referenceHeader.width != width || (size_t)referenceHeader.height != height)) {
+        throwError("The reference frame(-R) must have the size of the bitmap");
     }
+    if (profile != NULL && !isRle4 && !isQuantised) versionNumber = selectTunedVersion(profile, inPixelPointer, width, height, stride);
+    // delta escapes move the cursor across scan lines, so the delta encoder runs on one thread as well
+    bmpRleFunction bmpRle = isRle4 ? bmpRle4 : isDelta ? bmpRleDelta : getCompressionFunction(versionNumber);
+    if (isQuantised) bmpRle = header.bitCount == BITS_PER_PIXEL_24 ? bmpRleQuantise24 : bmpRleQuantise32;
+    // like delta escapes, the skips over unchanged pixels of an update cross scan lines
+    const uint8_t isSequential = isRle4 || isDelta || isQuantised || reference != NULL;
+    bmpRleMeasureFunction bmpRleMeasure = isSequential ? NULL : getMeasureFunction(versionNumber);
+    if (isSequential) threadCount = 1;
 
-    const uint32_t offBits = writeBitmapMetadataForRle(inputBuffer, outputBuffer);
-    const uint32_t width = getWidth(outputBuffer);
-    const uint32_t height = getHeight(outputBuffer);
-    const uint8_t* inPixelPointer = moveToPixelData(inputBuffer);
-    uint8_t* outPixelPointer = moveToPixelData(outputBuffer);
-    size_t rleSize;
-    size_t(*bmpRle)(const uint8_t*, size_t, size_t, uint8_t*) = bmpCompressionFunctionPointer[versionNumber];
-    if (isBenchmark) {
-        double totalTime = 0.0;
-        struct timespec start;
-        struct timespec end;
-
-        for (int i = 1; i <= repetitions + 1; i++) {
-            // measure time and execute compression function
-            clock_gettime(CLOCK_MONOTONIC, &start);
-            rleSize = bmpRle(inPixelPointer, width, height, outPixelPointer);
-            clock_gettime(CLOCK_MONOTONIC, &end);
-
-            double time = start.tv_sec - end.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
-            totalTime += time;
-
-            printf("%d. Run: %f\n", i, time);
+    // get buffer to write the compressed pixel data into
+    // if the version can measure its output, the buffer and the offset of every scan line are exact
+    // and a regular output file is mapped at its final size, so the bitmap is compressed straight into the file
+    size_t* lineSizes = NULL;
+    size_t pixelDataSize = getMaxPixelDataSizeForRle(inputBuffer);
+    if (bmpRleMeasure != NULL) {
+        lineSizes = malloc(sizeof(size_t) * height);
+        if (lineSizes == NULL) throwSystemError("Error while allocating memory");
+        pixelDataSize = bmpRleMeasure(inPixelPointer, width, height, stride, lineSizes);
+    }
+    // -D writes the background as index 0, the palette is reordered to match
+    const int background = isDelta ? getDominantPixel(inPixelPointer, width, height, stride) : -1;
+    const uint32_t offBits = isQuantised ? QUANTISED_OFF_BITS : isDelta ? calcOffBitsForDeltaRle(inputBuffer, background) : calcOffBitsForRle(inputBuffer);
+    if (bmpRleMeasure != NULL && !isRleSizeValid(offBits, pixelDataSize)) throwValidationError(ERROR_TOO_LARGE);
+    uint8_t* outputMapping = bmpRleMeasure != NULL ? mapOutputFile(ptrOut, offBits + pixelDataSize) : NULL;
+    // a large bitmap that can't be compressed straight into the output file is compressed and written in tiles of scan lines,
+    // so the output buffer is bounded (delta escapes cross scan lines, so delta and updates are never tiled)
+    const uint8_t isTiled = outputMapping == NULL && !isBenchmark && !isDelta && reference == NULL && pixelDataSize > TILE_OUTPUT_SIZE;
+    // the offset of every compressed scan line for the row index
+    size_t* rowOffsets = NULL;
+    if (indexFile != NULL) {
+        rowOffsets = malloc(sizeof(size_t) * (height + 1));
+        if (rowOffsets == NULL) throwSystemError("Error while allocating memory");
+    }
+    uint8_t* outPixelPointer = NULL;
+    if (outputMapping != NULL) {
+        writeBitmapMetadataForRle(inputBuffer, outputMapping);
+        outPixelPointer = outputMapping + offBits;
+    }
+    else if (!isTiled) {
+        outPixelPointer = malloc(pixelDataSize);
+        if (outPixelPointer == NULL) throwSystemError("Error while allocating memory");
+    }
 
-        }
-        printf("Average time per Run: %f\nTotal time: %f\n", totalTime / (repetitions + 1), totalTime);
+    size_t rleSize;
+    if (isTiled) {
+        uint8_t outHeader[MAX_INFO_OFF_BITS];
+        if (isQuantised) writeBitmapMetadataForQuantisedRle(inputBuffer, outHeader);
+        else writeBitmapMetadataForRle(inputBuffer, outHeader);
+        const struct tiledJob job = { inPixelPointer, width, height, stride, bmpRle, threadCount, lineSizes, rowOffsets };
+        rleSize = bmpRleTiled(&job, outHeader, offBits, ptrOut);
+    }
+    else if (isBenchmark) {
+        // -B n measures n + 1 runs, the report must not mix with a bitmap written to stdout
+        benchmarkOptions.runs = repetitions + 1;
+        char label[16];
+        snprintf(label, sizeof(label), isQuantised ? "quantise" : isRle4 ? "RLE4" : isDelta ? "delta" : "V%ld", versionNumber);
+        rleSize = bmpRleBenchmark(inPixelPointer, width, height, stride, outPixelPointer, pixelDataSize, bmpRle, threadCount, lineSizes,
+            &benchmarkOptions, label, ptrOut == stdout ? stderr : stdout);
+    }
+    else if (isDelta) {
+        // the background of the palette, not searched again
+        rleSize = bmpRleDeltaBackground(inPixelPointer, width, height, stride, background, outPixelPointer);
+    }
+    else if (reference != NULL) {
+        rleSize = bmpRleInterFrame(inPixelPointer, reference, width, height, stride, getBitmapStride(&referenceHeader), outPixelPointer);
     }
     else {
         // execute compression function
-        rleSize = bmpRle(inPixelPointer, width, height, outPixelPointer);
+        rleSize = bmpRleParallel(inPixelPointer, width, height, stride, outPixelPointer, bmpRle, threadCount, lineSizes);
     }
+    // the quantising and delta versions return 0 if their line buffer can't be allocated
+    if (rleSize == 0) throwSystemError("Error while allocating memory");
 
-    uint32_t size = writeBitmapSizesForRle(outputBuffer, offBits, rleSize);
+    // measured scan lines give the offsets for free, otherwise the tokens are walked once (tiles are indexed while compressed)
+    if (rowOffsets != NULL && !isTiled) {
+        rowOffsets[0] = 0;
+        for (size_t i = 0; lineSizes != NULL && i < height; i++) {
+            rowOffsets[i + 1] = rowOffsets[i] + lineSizes[i];
+        }
+        code = lineSizes != NULL ? SUCCESS_BITMAP_VALIDATION : bmpRleIndexRows(outPixelPointer, rleSize, height, rowOffsets);
+        if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+    }
 
     // write compressed output
-    fwrite(outputBuffer, size, 1, ptrOut);
+    if (outputMapping != NULL) {
+        writeBitmapSizesForRle(outputMapping, offBits, rleSize);
+        munmap(outputMapping, offBits + pixelDataSize);
+    }
+    else if (!isTiled) {
+        if (!isRleSizeValid(offBits, rleSize)) throwValidationError(ERROR_TOO_LARGE);
+        writeCompressedBitmap(inputBuffer, outPixelPointer, rleSize, isQuantised, background, ptrOut);
+        free(outPixelPointer);
+    }
 
-    printf("%s", "Bitmap succesfully written\n");
+    if (rowOffsets != NULL) writeRowIndexFile(indexFile, rowOffsets, height);
+
+    // the success message would corrupt the bitmap written to stdout or the JSON report
+    if (ptrOut != stdout && !benchmarkOptions.isJson) printf("%s", "Bitmap succesfully written\n");
 
     // close pointer & free buffer
     fclose(ptrOut);
-    free(inputBuffer);
-    free(outputBuffer);
+    munmap(inputBuffer, inputSize);
+    if (referenceBuffer != NULL) munmap(referenceBuffer, referenceSize);
+    free(lineSizes);
+    free(rowOffsets);
 
     return 0;
 }
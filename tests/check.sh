@@ -0,0 +1,148 @@
+#!/bin/bash
+# Round trip and equivalence checks of bmpRle on synthetic bitmaps of bmpGenerate
+# Every bitmap is compressed with every version and decompressed again (-d), the pixels must survive
+# V7 must be as small as the brute-force optimum of tests/optimal_size.c and never larger than another version
+# Every version must write the same bytes on several threads and for the top-down bitmap of the same image
+# With a reference binary (e.g. bmpRle built from an earlier commit) every output must also be byte-identical to its output
+#
+# usage: tests/check.sh [REFERENCE_BMPRLE], run from the directory of the Makefile after 'make' and 'make generator'
+# or with 'make check', BMP_RLE, BMP_GENERATE and OPTIMAL_SIZE override the binaries under test
+
+BMP_RLE=${BMP_RLE:-./bmpRle}
+BMP_GENERATE=${BMP_GENERATE:-./bmpGenerate}
+OPTIMAL_SIZE=${OPTIMAL_SIZE:-./tests/optimalSize}
+REFERENCE=${1:-}
+VERSIONS="0 1 2 3 4 5 6 7"
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+checks=0
+failures=0
+
+fail() {
+    echo "FAIL $*" >&2
+    failures=$((failures + 1))
+}
+
+# compress NAME OUTPUT OPTIONS..., compresses bitmap NAME with OPTIONS and, with a reference binary, compares both outputs
+compress() {
+    local name=$1 output=$2
+    shift 2
+    if ! "$BMP_RLE" "$@" -o "$output" "$WORK/$name.bmp" > /dev/null; then
+        fail "$name $*: compression failed"
+        return 1
+    fi
+    if [ -n "$REFERENCE" ]; then
+        checks=$((checks + 1))
+        "$REFERENCE" "$@" -o "$WORK/reference.bmp" "$WORK/$name.bmp" > /dev/null
+        cmp -s "$output" "$WORK/reference.bmp" || fail "$name $*: differs from $REFERENCE"
+    fi
+}
+
+# checkRoundTrip NAME, compresses bitmap NAME with every version and decompresses it again
+# bitmaps with info, v4 or v5 header and zeroed padding are restored byte by byte,
+# the others (core header, garbage padding) must compress to the same bytes again
+checkRoundTrip() {
+    local name=$1 isExact=$2
+    for version in $VERSIONS; do
+        checks=$((checks + 1))
+        compress "$name" "$WORK/compressed.bmp" -V "$version" || continue
+        if ! "$BMP_RLE" -d -o "$WORK/decompressed.bmp" "$WORK/compressed.bmp" > /dev/null; then
+            fail "$name -V $version: decompression failed"
+            continue
+        fi
+        if [ "$isExact" = 1 ]; then
+            cmp -s "$WORK/$name.bmp" "$WORK/decompressed.bmp" || fail "$name -V $version: round trip differs"
+        else
+            "$BMP_RLE" -V "$version" -o "$WORK/recompressed.bmp" "$WORK/decompressed.bmp" > /dev/null
+            cmp -s "$WORK/compressed.bmp" "$WORK/recompressed.bmp" || fail "$name -V $version: round trip differs"
+        fi
+    done
+}
+
+# checkOptimal NAME, compares the size of V7 with the brute-force optimum and every other version
+checkOptimal() {
+    local name=$1
+    checks=$((checks + 1))
+    if ! "$BMP_RLE" -V 7 -o "$WORK/optimal.bmp" "$WORK/$name.bmp" > /dev/null; then
+        fail "$name -V 7: compression failed"
+        return
+    fi
+    "$OPTIMAL_SIZE" "$WORK/$name.bmp" "$WORK/optimal.bmp" || fail "$name -V 7: not the brute-force optimum"
+    local optimalSize
+    optimalSize=$(wc -c < "$WORK/optimal.bmp")
+    for version in $VERSIONS; do
+        [ "$version" = 7 ] && continue
+        checks=$((checks + 1))
+        "$BMP_RLE" -V "$version" -o "$WORK/compressed.bmp" "$WORK/$name.bmp" > /dev/null || continue
+        [ "$optimalSize" -le "$(wc -c < "$WORK/compressed.bmp")" ] || fail "$name -V 7: larger than -V $version"
+    done
+}
+
+# checkEquivalence NAME, compares every version on one thread with several threads and the top-down bitmap NAME-td
+checkEquivalence() {
+    local name=$1
+    for version in $VERSIONS; do
+        compress "$name" "$WORK/compressed.bmp" -V "$version" || continue
+        for threads in 2 3 7; do
+            checks=$((checks + 1))
+            compress "$name" "$WORK/threads.bmp" -V "$version" -T "$threads" || continue
+            cmp -s "$WORK/compressed.bmp" "$WORK/threads.bmp" || fail "$name -V $version -T $threads: differs from one thread"
+        done
+        [ -f "$WORK/$name-td.bmp" ] || continue
+        checks=$((checks + 1))
+        compress "$name-td" "$WORK/topdown.bmp" -V "$version" || continue
+        cmp -s "$WORK/compressed.bmp" "$WORK/topdown.bmp" || fail "$name-td -V $version: differs from bottom-up"
+    done
+}
+
+# bitmap NAME GENERATOR_OPTIONS..., writes bitmap NAME and runs every check on it
+bitmap() {
+    local name=$1
+    shift
+    if ! "$BMP_GENERATE" "$@" -o "$WORK/$name.bmp" > /dev/null; then
+        fail "$name: bmpGenerate $* failed"
+        return
+    fi
+    local isExact=1 isCore=0
+    case " $* " in
+    *" -f core "*) isExact=0 isCore=1 ;;
+    *" -g "*) isExact=0 ;;
+    esac
+    checkRoundTrip "$name" "$isExact"
+    checkOptimal "$name"
+    # core headers have no top-down bitmaps
+    rm -f "$WORK/$name-td.bmp"
+    if [ "$isCore" = 0 ] && ! "$BMP_GENERATE" "$@" -t -o "$WORK/$name-td.bmp" > /dev/null; then
+        fail "$name: bmpGenerate $* -t failed"
+    fi
+    checkEquivalence "$name"
+}
+
+# widths around the vector widths of the SIMD versions and the widths with their own scalar loop, 1 pixel wide scan lines
+# can't compare pixels across scan lines
+for width in 1 2 3 4 5 15 16 17 31 32 33 63 64 65 66 67 127 128 129 255 256 257 320 511 640 1000 1920; do
+    bitmap "w$width" -W "$width" -H 5 -p 16 -r 3 -s "$width"
+done
+for run in 1 2 3 4 8 64 300; do
+    bitmap "r$run" -W 700 -H 9 -r "$run" -s "$run"
+done
+for pattern in alternate1 alternate2 runs3 run3single runs256; do
+    bitmap "$pattern" -W 1100 -H 4 -p 4 -a "$pattern"
+done
+bitmap noise -W 500 -H 16 -p 8 -r 20 -n 0.1
+bitmap palette1 -W 300 -H 6 -p 1
+bitmap palette2 -W 601 -H 7 -p 2 -r 2
+bitmap core -W 203 -H 11 -f core -p 32 -r 5
+bitmap v4 -W 210 -H 3 -f v4 -r 6
+bitmap v5 -W 211 -H 3 -f v5 -r 7
+bitmap garbage -W 257 -H 5 -g -r 4
+bitmap tall -W 3 -H 600 -p 2 -r 2
+bitmap column -W 1 -H 300 -p 2 -g
+# repeated scan lines, their tokens are reused (bmp_rle_dedup.c)
+bitmap repeated -W 640 -H 200 -p 2 -r 100000
+bitmap repeated8 -W 8 -H 300 -p 2 -r 2
+bitmap repeatedNoise -W 96 -H 150 -p 2 -r 200 -n 0.002
+
+echo "$checks checks, $failures failed"
+[ "$failures" = 0 ]
@@ -0,0 +1,83 @@
+/*
+ * Brute-force reference of the size-optimal version (V7)
+ * Every scan line is tokenised by a dynamic program that tries every token at every position:
+ * encoded mode for every run length up to 255 of equal pixels and absolute mode for every count from 3 to 255,
+ * quadratic in the token length instead of the monotone queues of bmp_rle_optimal.c
+ * usage: optimalSize <input.bmp> <compressed.bmp>, fails if the pixel data of the compressed bitmap
+ * is not exactly as small as the smallest RLE_8 pixel data of the input
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bitmap.h"
+#include "util.h"
+
+#define MAX_ENCODED_RUN 255
+#define MIN_ABSOLUTE_COUNT 3
+#define MAX_ABSOLUTE_COUNT 255
+
+static uint8_t* readFile(const char* file, long* size) {
+    FILE* in = fopen(file, "rb");
+    if (in == NULL) throwSystemError("Error while opening input file");
+    if (fseek(in, 0, SEEK_END) != 0 || (*size = ftell(in)) == -1 || fseek(in, 0, SEEK_SET) != 0) {
+        throwSystemError("Error while reading input file");
+    }
+    uint8_t* buffer = malloc(*size);
+    if (buffer == NULL) throwSystemError("Error while allocating memory");
+    if (fread(buffer, 1, *size, in) != (size_t)*size) throwSystemError("Error while reading input file");
+    fclose(in);
+    return buffer;
+}
+
+/*
+ * Smallest size of the tokens of 'line' without end of line, 'cost' holds 'width' + 1 entries
+ */
+static size_t measureLine(const uint8_t* line, const size_t width, size_t* cost) {
+    cost[width] = 0;
+    for (size_t i = width; i-- > 0;) {
+        cost[i] = SIZE_MAX;
+        for (size_t count = 1; count <= MAX_ENCODED_RUN && i + count <= width && line[i + count - 1] == line[i]; count++) {
+            if (2 + cost[i + count] < cost[i]) cost[i] = 2 + cost[i + count];
+        }
+        for (size_t count = MIN_ABSOLUTE_COUNT; count <= MAX_ABSOLUTE_COUNT && i + count <= width; count++) {
+            const size_t size = 2 + count + (count & 1) + cost[i + count];
+            if (size < cost[i]) cost[i] = size;
+        }
+    }
+    return cost[0];
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) throwError("usage: optimalSize <input.bmp> <compressed.bmp>");
+    long inputSize;
+    long compressedSize;
+    uint8_t* input = readFile(argv[1], &inputSize);
+    uint8_t* compressed = readFile(argv[2], &compressedSize);
+
+    struct bitmapHeader header;
+    const uint8_t code = parseBitmap(input, inputSize, &header);
+    if (code != SUCCESS_BITMAP_VALIDATION) throwValidationError(code);
+    const size_t width = header.width;
+    const size_t height = header.height;
+    const uint8_t* line = getBottomLine(input, &header);
+    const ptrdiff_t stride = getBitmapStride(&header);
+
+    size_t* cost = malloc(sizeof(size_t) * (width + 1));
+    if (cost == NULL) throwSystemError("Error while allocating memory");
+    // end of line after every scan line, the last one is end of bitmap
+    size_t optimalSize = 2 * height;
+    for (size_t i = 0; i < height; i++) {
+        optimalSize += measureLine(line, width, cost);
+        line += stride;
+    }
+
+    const size_t pixelDataSize = compressedSize - getOffBits(compressed);
+    free(cost);
+    free(input);
+    free(compressed);
+    if (pixelDataSize != optimalSize) {
+        fprintf(stderr, "%s: %zu bytes of pixel data, the optimum is %zu bytes\n", argv[2], pixelDataSize, optimalSize);
+        return 1;
+    }
+    return 0;
+}
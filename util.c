@@ -4,7 +4,7 @@
 #include "bitmap.h"
 #include "util.h"
 
-void throwError(char* errorMessage) {
+_Noreturn void throwError(char* errorMessage) {
     fprintf(stderr, "%s\n", errorMessage);
     exit(1);
 }
@@ -24,38 +24,7 @@ long getNumberAsLong(char* numberPtr) {
 }
 
 void throwValidationError(const uint8_t code) {
-    switch (code) {
-    case ERROR_TOO_SMALL:
-        throwError("Bitmap file is too small");
-    case ERROR_INVALID_FILE_SIZE:
-        throwError("The bitmap declares a wrong file size");
-    case ERROR_WRONG_FILE_TYPE:
-        throwError("The file is not a bitmap");
-    case ERROR_WRONG_WIDTH:
-        throwError("Something is wrong with the specified width of the bitmap");
-    case ERROR_WRONG_HEIGHT:
-        throwError("Something is wrong with the specified height of the bitmap");
-    case ERROR_ALREADY_COMPRESSED:
-        throwError("The Bitmap was already compressed, please use an uncompressed bitmap for compression");
-    case ERROR_BITS_PER_PIXEL:
-        throwError("Bits per pixel should be 8");
-    case ERROR_WRONG_PLANES:
-        throwError("Invalid plane number in bitmap");
-    case ERROR_INVALID_INFO_HEADER_SIZE:
-        throwError("Invalid information header size");
-    case ERROR_CLR_USED:
-        throwError("Invalid number of colors used");
-    case ERROR_CLR_IMPORTANT:
-        throwError("Invalid number of important colors used");
-    case ERROR_WRONG_OFF_BITS:
-        throwError("Invalid off bits number");
-    case ERROR_NO_TOP_DOWN:
-        throwError("Top Down Bitmaps are not supported");
-    case ERROR_INVALID_COLOR_PALETTE_SIZE:
-        throwError("Check your Bitmap, something is wrong with the size of the color palette");
-    default:
-        throwError("Something unexpected happened");
-    }
+    throwError(getValidationErrorMessage(code));
 }
 
 void printUsage() {
@@ -63,43 +32,53 @@ void printUsage() {
     char* help =
         "bmpRle\n\n"
         "\033[1mNAME\033[0m\n"
-        "\tbmpRle - compress an 8bpp bitmap file using RLE_8 compression\n\n"
+        "\tbmpRle - compress an 8bpp or 4bpp bitmap file using RLE_8 or RLE_4 compression\n\n"
         "\033[1mSYNOPSIS\033[0m\n"
-        "\tbmpRle [-V=<USED_VERSION>] [-B=<AMOUNT_OF_REPETITIONS>] [-o=<OUTPUT_FILE_PATH>] [-h] <INPUT_FILE_PATH>\n\n"
+        "\tbmpRle [-V=<USED_VERSION>] [--tune] [--profile=<PROFILE_FILE>] [-B=<AMOUNT_OF_REPETITIONS> [--warmup=<RUNS>] [--cpu=<CPU>] [--cold] [--json] [--counters]] [-T=<THREADS>] [-o=<OUTPUT_FILE_PATH>] [-O=<OUTPUT_DIRECTORY> [-M=<MANIFEST_FILE>]] [-d] [-D] [-R=<REFERENCE_FILE_PATH>] [--update=<COMPRESSED_FILE_PATH> --rows=<Y0-Y1,...>] [--index=<INDEX_FILE_PATH>] [-h] <INPUT_FILE_PATH | -> ...\n"
+        "\tbmpRle [-V=<USED_VERSION>] [-T=<WORKERS>] --daemon=<SOCKET_PATH>\n"
+        "\tbmpRle [-B=<AMOUNT_OF_REPETITIONS>] [-o=<OUTPUT_FILE_PATH>] --connect=<SOCKET_PATH> <INPUT_FILE_PATH>\n\n"
         "\033[1mOPTIONS\033[0m\n"
-        "\t-V\tUsed version\n\n"
-        "\t-B\tAmount of repetitions\n\n"
-        "\t-o\tPath to output file (default ./out.bmp)\n\n"
-        "\t-h, --help\n\t\t Show help\n"
+        "\t-V\tUsed version in [0,7], 'auto' for the version tuned for the content of the bitmap on this host (see --tune,\n\t\twithout profile the widest SIMD version supported by this CPU) or 'optimal' (V7) for the smallest output\n\t\t(4bpp bitmaps always use RLE_4, 24bpp and 32bpp bitmaps are quantised\n\t\tto the fixed 3-3-2 palette and compressed with V6)\n\n"
+        "\t--tune\tMeasure all versions on synthetic content classes and write the tuning profile of this host\n\t\t(default $XDG_CONFIG_HOME/bmprle/<host>.profile or ~/.config/bmprle/<host>.profile)\n\n"
+        "\t--profile\tPath to the tuning profile used by --tune and -V auto\n\n"
+        "\t-B\tAmount of repetitions, -B n measures n + 1 runs and reports min, median, p95, p99,\n\t\tMB/s and cycles per pixel\n\n"
+        "\t--warmup\tRuns discarded before measuring (default 1)\n\n"
+        "\t--cpu\tPin the benchmark (and the threads it starts) to this CPU\n\n"
+        "\t--cold\tFlush input and output from the caches before every run\n\n"
+        "\t--json\tPrint the benchmark report as JSON\n\n"
+        "\t--counters\tReport cycles, instructions, IPC, branch, L1D and LLC misses (perf_event_open) per run,\n\t\tmegapixel and output token, timings only if the counters are not available\n\n"
+        "\t-T\tAmount of threads, the bitmap is split into bands of scan lines (default 1), with -d the RLE_8 bands are decoded in parallel\n\n"
+        "\t-o\tPath to output file (default ./out.bmp), '-' writes to stdout\n\n"
+        "\t-O\tBatch mode, compress every input file into this directory keeping its file name,\n\t\t-T workers compress one file each, failing files are reported and skipped\n\n"
+        "\t-M\tManifest file with one input file per line (batch mode only)\n\n"
+        "\t-d\tDecompress an RLE_8 or RLE_4 bitmap instead of compressing\n\n"
+        "\t-D\tSkip the most frequent pixel (background) with delta escapes, 8bpp only\n\t\t(the background is swapped with palette index 0, which decoders put into skipped pixels)\n\n"
+        "\t-R\tCompress only the pixels that differ from this reference frame (the previous 8bpp frame of a sequence),\n\t\twith -d the update is played back over the reference frame\n\n"
+        "\t--update\tRe-encode only the dirty scan lines (--rows) of the 8bpp input in this RLE_8 bitmap,\n\t\twhich was compressed from an earlier state of the input, the bitmap is updated in place\n\n"
+        "\t--rows\tDirty scan lines y0-y1 (inclusive, counted from the top of the image), separated by ',',\n\t\twith -d only the scan lines y0-y1 are decoded into a bitmap of their own\n\n"
+        "\t--index\tRow index of the RLE_8 bitmap (offset of every compressed scan line), written while compressing,\n\t\tread by -d and --update instead of walking the tokens\n\n"
+        "\t--daemon\tServe compression requests on this Unix socket until SIGINT or SIGTERM, bitmaps are passed as memfd descriptors,\n\t\t-T workers with warm buffers serve one connection each\n\n"
+        "\t--connect\tCompress the input by the daemon listening on this socket, with -B the mean latency of a request is reported\n\n"
+        "\t-h, --help\n\t\t Show help\n";
+    // split, so every literal stays below the length ISO C compilers must support
+    char* examples =
         "\033[1mINSTALLATION\033[0m\n\n"
         "\tmake\tCreate an exectuable main\n\n"
         "\033[1mSAMPLE EXECUTIONS\033[0m\n\n"
         "\t./bmpRle input.bmp\n"
         "\t./bmpRle -V0 -B0 input.bmp\n"
-        "\t./bmpRle -V1 -B10 -o out.bmp input.bmp\n\n";
-
-    fprintf(stdout, "%s", help);
-}
-
-void printUsage() {
-
-    char* help =
-        "salsa20\n\n"
-        "NAME\n\n"
-        "\tsalsa20 - stream sypher algorithm used to encrypt/decrypt a message\n\n"
-        "SYNOPSIS\n\n"
-        "\tsalsa20 [-V=<DEFINED_VERSION>] [-B=<NUMBER_OF_FUNCTION_REPETITIONS>] [-o=<OUTPUT_FILE>] [-k=<KEY>] [-iv=<NONCE>] <INPUT_FILE> [-h]\n\n"
-        "OPTIONS\n\n"
-        "\t-V\tUsed version, default version is 0\n\n"
-        "\t-B\tAmount of repetitions of salsa20_crypt function\n\n"
-        "\t-o\tPath to output file (default ./out.txt)\n\n"
-        "\t-h, --help\n\t\t Display help\n"
-        "EXECUTION\n\n"
-        "\tmake - Compiles and creates Executable\n\n"
-        "EXAMPLES\n\n"
-        "\t./salsa20 -k 123 -iv 12345 input.txt\n"
-        "\t./salsa20 -V0 -B10 -k 123 -iv 12345 -o output.txt input.txt\n"
+        "\t./bmpRle -V1 -B10 -o out.bmp input.bmp\n"
+        "\t./bmpRle -V6 -B99 --warmup 5 --cpu 2 --cold --json input.bmp\n"
+        "\t./bmpRle -D -o overlay.bmp input.bmp\n"
+        "\t./bmpRle -R frame41.bmp -o update42.bmp frame42.bmp\n"
+        "\t./bmpRle --update canvas_rle.bmp --rows 100-120,500 canvas.bmp\n"
+        "\tproducer | ./bmpRle -o - - | consumer\n"
+        "\t./bmpRle -T8 -O out -M manifest.txt\n"
+        "\t./bmpRle -d -o decompressed.bmp compressed.bmp\n"
+        "\t./bmpRle --index map.idx -o map_rle.bmp map.bmp\n"
+        "\t./bmpRle -d -T4 --index map.idx --rows 1000-1999 -o band.bmp map_rle.bmp\n"
+        "\t./bmpRle -V6 -T4 --daemon /run/bmprle.sock\n"
+        "\t./bmpRle --connect /run/bmprle.sock -o out.bmp input.bmp\n\n";
 
-    fprintf(stdout, "%s", help);
+    fprintf(stdout, "%s%s", help, examples);
 }
-
@@ -2,7 +2,7 @@
  * Header file for util.c
  */
 
-void throwError(char* errorMessage);
+_Noreturn void throwError(char* errorMessage);
 void throwSystemError(char* errorMessage);
 void throwValidationError(const uint8_t code);
 void printUsage();